@@ -7,6 +7,7 @@
 #include "PageState.hpp"
 #include "io/IoInterface.hpp"
 #include "io/IoRequest.hpp"
+#include "io/IoTrace.hpp"
 #include "io/impl/NvmeLog.hpp"
 
 #include <fcntl.h>
@@ -43,6 +44,7 @@
 #include <random>
 #include <algorithm>
 #include <array>
+#include <deque>
 
 namespace mean {
 
@@ -66,6 +68,10 @@ struct JobOptions {
    float rateLimit = 0;
    float totalRate = 0;
    bool exponentialRate = true;
+   // open loop: arrivals are scheduled by the rate, independent of completions; latency is
+   // measured from the intended start, arrivals that cannot be issued yet queue up as backlog
+   bool openLoop = false;
+   u64 maxBacklog = 1 << 20;
    int threads = 1;
    bool printEverySecond = false;
    string logHash = "";
@@ -80,6 +86,11 @@ struct JobOptions {
 
    bool trackPatternAccess = false;
 
+   // how the threads share the pattern: one PatternGen for all threads, or one per thread
+   // over a contiguous slice or every threads-th block of the file
+   enum class Partition { Shared, Slice, Interleave };
+   Partition partition = Partition::Shared;
+
    // Stats options
    bool enableIoTracing = false;
    bool enableLatenyTracking = true;
@@ -115,6 +126,7 @@ struct JobOptions {
       ss << ", iodepth_batch_complete_min: " << iodepth_batch_complete_min;
       ss << ", iodepth_batch_complete_max: " << iodepth_batch_complete_max;
       ss << ", fdatasync: " << fdatasync;
+      ss << ", partition: " << (int)partition;
       ss << std::endl;
       return ss.str();
    }
@@ -158,6 +170,13 @@ struct JobStats {
 
    Hist<int, int> cycleHistEverySecond{histBuckets, histFrom, histTo};
 
+   // open loop: intended start -> push, arrivals waiting for a free request
+   Hist<int, int> lagHistEverySecond{histBuckets, histFrom, histTo};
+   u64 backlog = 0;
+   u64 backlogMaxEverySecond = 0;
+   u64 backlogMax = 0;
+   u64 droppedArrivals = 0;
+
    JobStats(u64 bs) : bs(bs), iopsPerSecond(maxSeconds), readsPerSecond(maxSeconds), writesPerSecond(maxSeconds) {
       assert(iopsPerSecond.size() == maxSeconds);
    }
@@ -175,6 +194,9 @@ struct JobStats {
          fdatasyncHistEverySecond.writePercentilesHeader("s", result);
          result += ",c,";
          cycleHistEverySecond.writePercentilesHeader("c", result);
+         result += ",backlog,backlogMax,droppedArrivals";
+         result += ",l,";
+         lagHistEverySecond.writePercentilesHeader("l", result);
          result += "\n";
       }
 
@@ -212,57 +234,24 @@ struct JobStats {
       fdatasyncHistEverySecond.writePercentiles(result);
       result += ",c,";
       cycleHistEverySecond.writePercentiles(result);
+      result += "," + std::to_string(backlog);
+      result += "," + std::to_string(backlogMaxEverySecond);
+      result += "," + std::to_string(droppedArrivals);
+      result += ",l,";
+      lagHistEverySecond.writePercentiles(result);
 
       // reset hists
       readHistEverySecond.resetData();
       writeHistEverySecond.resetData();
       fdatasyncHistEverySecond.resetData();
       cycleHistEverySecond.resetData();
+      lagHistEverySecond.resetData();
+      backlogMaxEverySecond = backlog;
 
       lastFdatasync = fdatasyncs;
    }
 };
  
-struct IoTrace {
-   struct IoStat {
-      int threadId;
-      int reqId;
-      uint64_t begin;
-      uint64_t submit;
-      uint64_t end;
-      u64 addr;
-      u32 len;
-      IoRequestType type;
-
-      static void dumpIoStatHeader(std::ostream& out, std::string prefix) {
-         out << prefix << "threadid,reqId,type, begin, submit, end, addr, len";
-      }
-      void dumpIoStat(std::string prefix, std::ostream& out) {
-         out << prefix << threadId << "," << reqId << "," << (int)type << "," << nanoFromTsc(begin) << "," << nanoFromTsc(submit) << "," << nanoFromTsc(end) << ","  << addr << "," << len;
-      }
-   };
-   std::vector<IoStat> ioTrace;
-   bool ioTracing = false;
-   uint64_t evaluatedtIos = 0;
-
-   void setIoTracing(bool enable) {
-      ioTracing = enable;
-      if (enable) {
-         ioTrace.resize(10000000);
-      }
-   }
-
-   static void dumpIoTreaceHeader(std::ostream& out, std::string prefix) {
-      IoStat::dumpIoStatHeader(out, prefix); out << std::endl;
-   }
-   void dumpIoTrace(std::ostream& out, std::string prefix = "") {
-      for (uint64_t i = 0; i < evaluatedtIos; i++) {
-         ioTrace[i].dumpIoStat(prefix, out); 
-         out << std::endl;
-      }
-   }
-};
-
 class RequestGenerator {
 public:
    std::string name;
@@ -270,7 +259,7 @@ public:
    const JobOptions options;
    iob::PatternGen& patternGen;
    FileState& fileState;
-   IoTrace ioTrace;
+   IoTraceRing* ioTrace = nullptr; // streamed by the global IoTraceWriter
 
    JobStats stats;
    
@@ -295,6 +284,8 @@ public:
 
    std::vector<u64> availableReqStack;
    int availableReqStackCnt = 0;
+   std::vector<u64> intendedStart; // per request id, tsc
+   std::deque<u64> arrivals; // open loop backlog, intended starts (tsc)
 
    unsigned long bss = options.totalMinusOffsetBlocks() / options.threads;
    std::uniform_int_distribution<unsigned long> rbs_dist{0, bss};
@@ -313,26 +304,25 @@ public:
    RequestGenerator& operator=(RequestGenerator&& other) = delete; 
 
    RequestGenerator(std::string name, JobOptions& options, IoChannel& ioChannel, int genId, atomic<long>& time, iob::PatternGen& patternGen, FileState& fileState) 
-      : name(name), options(options), genId(genId), stats(options.bs), patternGen(patternGen), ioChannel(ioChannel),time(time), availableReqStack(options.iodepth), rateLimitExpDist(options.rateLimit), fileState(fileState) {
-      ioTrace.setIoTracing(options.enableIoTracing);
+      : name(name), options(options), genId(genId), stats(options.bs), patternGen(patternGen), ioChannel(ioChannel),time(time), availableReqStack(options.iodepth), intendedStart(options.iodepth), rateLimitExpDist(options.rateLimit), fileState(fileState) {
+      if (options.enableIoTracing && IoTraceWriter::global()) {
+         ioTrace = &IoTraceWriter::global()->ring(genId);
+      }
       readData = std::make_unique<char*[]>(options.iodepth);
       writeData = std::make_unique<char*[]>(options.iodepth);
 
       int align = 0;
-      //rd = (char*)IoInterface::allocIoMemoryChecked(((options.iodepth + align)*options.bs) + 512, 512) + 512;
-      rd = (char*)IoInterface::allocIoMemoryChecked(((options.iodepth + align)*options.bs), 512);
+      // buffers come from the hugepage backed pool of this generator's channel, registered there once
+      auto& bufferPool = IoInterface::bufferPool(genId);
+      rd = (char*)bufferPool.alloc(((options.iodepth + align)*options.bs), 512);
       //std::cout << "rd align 4096: " << (u64)((u64)rd % 4096) << " 512: " <<  (u64)((u64)rd % 512) << std::endl;
-      //wd = (char*)IoInterface::allocIoMemoryChecked(((options.iodepth + align)*options.bs) + 512, 512);
       // WELL, seems like it is slower when not aligned to 4K
-      wd = (char*)IoInterface::allocIoMemoryChecked(((options.iodepth + align)*options.bs), 512);
-      std::vector<std::pair<void*, uint64_t>> iovec;
+      wd = (char*)bufferPool.alloc(((options.iodepth + align)*options.bs), 512);
       for (int i = 0; i < options.iodepth; i++) {
-         readData[i] = rd + ((align + options.bs)*i) + 0; //(char*) IoInterface::allocIoMemoryChecked(options.bs, 1);
-         writeData[i] = wd + ((align + options.bs)*i) + 0;// (char*) IoInterface::allocIoMemoryChecked(options.bs, 1);
+         readData[i] = rd + ((align + options.bs)*i) + 0;
+         writeData[i] = wd + ((align + options.bs)*i) + 0;
          memset(writeData[i], 'B', options.bs);
          memset(readData[i], 'A', options.bs);
-         iovec.push_back(std::pair(readData[i], options.bs));
-         iovec.push_back(std::pair(writeData[i], options.bs));
          availableReqStack[i] = i;
       }
       availableReqStackCnt = options.iodepth;
@@ -342,18 +332,11 @@ public:
          statsFileExists = fileExists.good();
       }
       statsFile.open(statsFileName, std::ios_base::app);
-      //ioChannel.registerBuffers(iovec);
    }
 
    ~RequestGenerator() {
-      IoInterface::freeIoMemory(rd);
-      IoInterface::freeIoMemory(wd);
-      /*
-      for (int i = 0; i < options.iodepth; i++) {
-         //IoInterface::freeIoMemory(readData[i]);
-         //IoInterface::freeIoMemory(writeData[i]);
-      }
-      */
+      IoInterface::bufferPool(genId).release(rd);
+      IoInterface::bufferPool(genId).release(wd);
    }
 
    /*
@@ -411,8 +394,19 @@ public:
       while ((ops <= 0 || completed < ops) && keep_running) {
          //do {
             if (options.breakEvery <= 0 || (time+1) % (options.breakEvery + options.breakFor) < options.breakEvery) { // check if there is a break
+               if (options.openLoop) {
+                  scheduleArrivals(nextStartTime);
+               }
                while (availableReqStackCnt > 0 && ((ops <= 0 || completed < ops) && keep_running)) {
-                  if (options.rateLimit > 0) { // when rate limiting is enabled only add more if needed
+                  u64 intended = 0;
+                  if (options.openLoop) {
+                     if (arrivals.empty()) {
+                        break;
+                     }
+                     intended = arrivals.front();
+                     arrivals.pop_front();
+                     stats.backlog = arrivals.size();
+                  } else if (options.rateLimit > 0) { // when rate limiting is enabled only add more if needed
                      auto now = mean::readTSC();
                      if (now >= nextStartTime) {
                         if (mean::tscDifferenceS(now, nextStartTime) > 5) {
@@ -420,11 +414,7 @@ public:
                            nextStartTime = now;
                            std::cout << "reset" << std::endl << std::flush;
                         }
-                        double d = 1/options.rateLimit;
-                        if (options.exponentialRate) {
-                           d = rateLimitExpDist(gen);
-                        }
-                        nextStartTime += mean::nsToTSC(d*1e9);
+                        nextStartTime += nextInterarrivalTsc();
                      } else {
                         break;
                      }
@@ -433,10 +423,15 @@ public:
                   availableReqStackCnt--;
                   reqCpy.id = availableReqStack[availableReqStackCnt];
                   reqCpy.user = cb;
+                  if (options.openLoop) {
+                     intendedStart[reqCpy.id] = intended;
+                     stats.lagHistEverySecond.increaseSlot(tscDifferenceUs(readTSC(), intended));
+                  }
                   prepareRequest(reqCpy);
 
-                  // if request addr is dividable by page size, the submit a trim command first
-                  if (patternGen.pattern == iob::PatternGen::Pattern::ZNS && reqCpy.addr % (patternGen.options.znsPagesPerZone * reqCpy.len) == 0) {
+                  // the pattern opened a zone (per thread with PARTITION=slice), reset it first
+                  if (zoneStart) {
+                     zoneStart = false;
                      int fd = IoInterface::instance().getDeviceInfo().devices[0].fd;
                      uint64_t range[2];
                      range[0] = reqCpy.addr;
@@ -451,6 +446,11 @@ public:
                   submitted++;
                }
                ioChannel.submit();
+            } else if (options.openLoop) {
+               // no arrivals during breaks
+               nextStartTime = mean::readTSC();
+               arrivals.clear();
+               stats.backlog = 0;
             }
 
          auto doPoll = [&]() {
@@ -504,28 +504,67 @@ public:
       }
       std::stringstream ss;
       ioChannel.printCounters(ss);
+      if (options.openLoop) {
+         ss << " open loop: backlog: " << stats.backlog << " max backlog: " << stats.backlogMax << " dropped arrivals: " << stats.droppedArrivals;
+      }
       ss << endl;
       cout << ss.str() << std::flush;
       return 0;
    }
 
+   u64 nextInterarrivalTsc() {
+      double d = 1/options.rateLimit;
+      if (options.exponentialRate) {
+         d = rateLimitExpDist(gen);
+      }
+      return mean::nsToTSC(d*1e9);
+   }
+   // open loop: queue every arrival that is due by now, even if no request is free
+   void scheduleArrivals(u64& nextArrival) {
+      const u64 now = mean::readTSC();
+      while (nextArrival <= now) {
+         if (arrivals.size() < options.maxBacklog) {
+            arrivals.push_back(nextArrival);
+         } else {
+            stats.droppedArrivals++;
+         }
+         nextArrival += nextInterarrivalTsc();
+      }
+      stats.backlog = arrivals.size();
+      stats.backlogMaxEverySecond = std::max(stats.backlogMaxEverySecond, stats.backlog);
+      stats.backlogMax = std::max(stats.backlogMax, stats.backlog);
+   }
+
    float sumFreq = 0;
    std::vector<uint64_t> patternAccess;
    static constexpr int NEXT_SIZE = 1;
    int next_seq_ptr = NEXT_SIZE;
    std::array<uint64_t, NEXT_SIZE> next_seq;
+   std::array<uint8_t, NEXT_SIZE> next_hint;
+   uint8_t lastHint = iob::PatternGen::noHint; // lifetime hint of the last generated address
+   bool zoneStart = false; // the last generated address starts a zone of this generator's pattern
    uint64_t patternGenerator() {
       uint64_t addr;
       if (next_seq_ptr == NEXT_SIZE) {
          for (int i = 0; i < NEXT_SIZE; i++) {
-            next_seq[i] = patternGen.accessPatternGenerator(gen);
+            next_seq[i] = patternGen.accessPatternGenerator(gen, next_hint[i]);
+         }
+         // deleted ranges (zone resets, file deletions) are not issued as trims, drop them
+         for (uint64_t first, count; patternGen.nextTrim(first, count);) {
          }
          next_seq_ptr=0;
       }
+      lastHint = next_hint[next_seq_ptr];
       uint64_t block = next_seq[next_seq_ptr++];
+      zoneStart = patternGen.pattern == iob::PatternGen::Pattern::ZNS && block % patternGen.options.znsPagesPerZone == 0;
+      if (options.partition == JobOptions::Partition::Slice) {
+         block += genId * patternGen.options.logicalPages;
+      } else if (options.partition == JobOptions::Partition::Interleave) {
+         block = block * options.threads + genId;
+      }
       if (options.trackPatternAccess) {
          if (patternAccess.size() == 0) {
-            patternAccess.resize(patternGen.options.logicalPages);
+            patternAccess.resize(options.totalMinusOffsetBlocks());
          }
          patternAccess.at(block)++;
       }
@@ -570,6 +609,7 @@ public:
    std::random_device randDev;
    std::mt19937_64 mersene{randDev()};
    void prepareRequest(IoBaseRequest& req) {
+      req.hint = iob::PatternGen::noHint;
       if (options.fdatasync > 0 && preparedWrites - lastFsync == (uint64_t)options.fdatasync) {
          //c->aio_lio_opcode = IO_CMD_FDSYNC;
          req.type = IoRequestType::Fsync;
@@ -594,6 +634,7 @@ public:
             //}
             //req.write_back = true;
             req.type = IoRequestType::Write;
+            req.hint = lastHint;
             req.data =  writeData[req.id];
             //std::cout << "w: " << req.addr << " len: " << req.len << std::endl;
             fileState.writeBufferChecks(req.data, req.addr, req.len, mersene);
@@ -620,17 +661,8 @@ public:
    uint64_t evaluateIocb(const IoBaseRequest& req) {
       uint64_t sum = 0;
       //ensure(req.device == genId);
-      if (options.enableIoTracing) {
-         IoTrace::IoStat& ios = ioTrace.ioTrace.at(ioTrace.evaluatedtIos);
-         ios.threadId = genId;
-         ios.reqId = req.id;
-         ios.begin = req.stats.push_time;
-         ios.submit = req.stats.submit_time;
-         ios.end = req.stats.completion_time;
-         ios.type = req.type;
-         ios.addr = req.addr;
-         ios.len = req.len;
-         ioTrace.evaluatedtIos++;
+      if (ioTrace) {
+         ioTrace->push(genId, req);
       }
       if (!options.enableLatenyTracking) {
          if (req.type == IoRequestType::Read) {
@@ -643,7 +675,9 @@ public:
             raise(SIGTRAP);
          }
       } else {
-         const auto thisTime = tscDifferenceUs(readTSC(), req.stats.push_time);
+         // open loop: from the intended start, so queueing behind a stalled device is included
+         const u64 begin = options.openLoop ? intendedStart[req.id] : req.stats.push_time;
+         const auto thisTime = tscDifferenceUs(readTSC(), begin);
          if (req.type == IoRequestType::Fsync) {
             stats.fdatasyncTotalTime += thisTime;
             stats.fdatasyncHist.increaseSlot(thisTime);
@@ -35,9 +35,8 @@ class ThreadBase
       _this_thread = this;
       setNameThisThread(name);
       setCpuAffinityThisThread(cpuAffinity);
-      int pid = getpid();
-      int which = PRIO_PROCESS;
-      posix_check(setpriority(which, pid, 39) == 0, "prio could not be set");
+      // with a tid, PRIO_PROCESS only changes this thread and not the whole process
+      posix_check(setpriority(PRIO_PROCESS, gettid(), 39) == 0, "prio could not be set");
 
       _ready = true;
       // u32   tid = gettid();
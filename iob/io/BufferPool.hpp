@@ -0,0 +1,130 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include "Topology.hpp"
+#include "Units.hpp"
+#include "Exceptions.hpp"
+// -------------------------------------------------------------------------------------
+#include <sys/mman.h>
+
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+// -------------------------------------------------------------------------------------
+namespace mean
+{
+// -------------------------------------------------------------------------------------
+// 2 MiB / 1 GiB pages from hugetlbfs, transparent hugepages if none are reserved.
+// The memory is bound to numaNode and touched once, so no page faults happen during I/O.
+struct HugePageMemory {
+   static void* alloc(u64& size, u64 hugePageSize, int numaNode)
+   {
+      const u64 pageSize = hugePageSize > 0 ? hugePageSize : 2 * MEBI;
+      size = (size + pageSize - 1) / pageSize * pageSize;
+      const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+      void* mem = MAP_FAILED;
+      if (hugePageSize == 2 * MEBI || hugePageSize == GIBI) {
+         const int shift = hugePageSize == GIBI ? 30 : 21;
+         mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+      }
+      if (mem == MAP_FAILED) {
+         mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+         if (mem == MAP_FAILED) {
+            return nullptr;
+         }
+         madvise(mem, size, MADV_HUGEPAGE);
+      }
+      topology::bindMemoryToNode(mem, size, numaNode);
+      madvise(mem, size, MADV_DONTFORK);  // O_DIRECT does not work with forking.
+      std::memset(mem, 0, size);
+      return mem;
+   }
+   static void free(void* ptr, u64 size) { munmap(ptr, size); }
+};
+// -------------------------------------------------------------------------------------
+// Per channel (= per worker thread) pool of I/O buffers. Memory is reserved in large
+// segments that are registered once with the channel (fixed buffers for io_uring) and
+// handed out as page aligned slices. Released slices are reused for the same size.
+// -------------------------------------------------------------------------------------
+class IoBufferPool
+{
+  public:
+   using SegmentAllocFun = std::function<void*(u64& size)>;
+   using SegmentFreeFun = std::function<void(void*, u64)>;
+   using RegisterFun = std::function<void(void*, u64)>;
+   static constexpr u64 MIN_SEGMENT_SIZE = 32 * MEBI;
+   static constexpr u64 SLICE_ALIGNMENT = 4096;
+  private:
+   struct Segment {
+      char* base;
+      u64 size;
+      u64 used;
+   };
+   std::mutex mutex;  // pools are per thread, but the main thread uses channel 0 during init
+   std::vector<Segment> segments;
+   std::unordered_map<u64, std::vector<char*>> freeSlices;
+   std::unordered_map<char*, u64> sliceSizes;
+   SegmentAllocFun segmentAlloc;
+   SegmentFreeFun segmentFree;
+   RegisterFun registerFun;
+   const int numaNode;
+   u64 reserved = 0;
+   u64 inUse = 0;
+  public:
+   IoBufferPool(int numaNode, SegmentAllocFun segmentAlloc, SegmentFreeFun segmentFree, RegisterFun registerFun = nullptr)
+      : segmentAlloc(segmentAlloc), segmentFree(segmentFree), registerFun(registerFun), numaNode(numaNode) {}
+   ~IoBufferPool()
+   {
+      for (auto& s : segments) {
+         segmentFree(s.base, s.size);
+      }
+   }
+   IoBufferPool(const IoBufferPool&) = delete;
+   IoBufferPool& operator=(const IoBufferPool&) = delete;
+   // -------------------------------------------------------------------------------------
+   void* alloc(u64 size, u64 align = 512)
+   {
+      ensurem(align <= SLICE_ALIGNMENT, "IoBufferPool: alignment larger than " + std::to_string(SLICE_ALIGNMENT));
+      size = (size + SLICE_ALIGNMENT - 1) / SLICE_ALIGNMENT * SLICE_ALIGNMENT;
+      std::unique_lock<std::mutex> guard(mutex);
+      inUse += size;
+      auto& reuse = freeSlices[size];
+      if (!reuse.empty()) {
+         char* ptr = reuse.back();
+         reuse.pop_back();
+         return ptr;
+      }
+      if (segments.empty() || segments.back().size - segments.back().used < size) {
+         u64 segmentSize = std::max(size, MIN_SEGMENT_SIZE);
+         char* base = (char*)segmentAlloc(segmentSize);
+         null_checkm(base, "IoBufferPool: segment allocation failed");
+         segments.push_back({base, segmentSize, 0});
+         reserved += segmentSize;
+         if (registerFun) {
+            registerFun(base, segmentSize);
+         }
+      }
+      auto& s = segments.back();
+      char* ptr = s.base + s.used;
+      s.used += size;
+      sliceSizes[ptr] = size;
+      return ptr;
+   }
+   void release(void* ptr)
+   {
+      std::unique_lock<std::mutex> guard(mutex);
+      auto it = sliceSizes.find((char*)ptr);
+      ensurem(it != sliceSizes.end(), "IoBufferPool: pointer not from this pool");
+      freeSlices[it->second].push_back((char*)ptr);
+      inUse -= it->second;
+   }
+   // -------------------------------------------------------------------------------------
+   int node() const { return numaNode; }
+   u64 reservedBytes() const { return reserved; }
+   u64 inUseBytes() const { return inUse; }
+};
+// -------------------------------------------------------------------------------------
+}  // namespace mean
+// -------------------------------------------------------------------------------------
@@ -8,11 +8,14 @@
 #include "Hist.hpp"
 #include "RequestStack.hpp"
 #include "Raid.hpp"
+#include "BufferPool.hpp"
+#include "Topology.hpp"
 // -------------------------------------------------------------------------------------
 #include <array>
 #include <atomic>
 #include <algorithm>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
@@ -43,6 +46,7 @@ class Raid0Channel : public IoChannel
    TIoEnvironment& io_env;
    TIoChannel& io_channel;
    IoOptions io_options;
+   IoBufferPool& buffer_pool;
    RequestStack<RaidRequest<TImplRequest>> request_stack;
    u64 pushTimeout = 0;
    int outstanding = 0;
@@ -50,49 +54,23 @@ class Raid0Channel : public IoChannel
    u64 pushedFromRemote = 0;
    u64 completed = 0;
    // ------------------------------------------------------------------------------------
-//#define IO_TRACE_ON
-#ifdef IO_TRACE_ON
-   struct TraceElement {
-      uint8_t type;
-      uint32_t addr;
-		uint32_t latency;
-      uint64_t tsc;
-      TraceElement(uint8_t _type, uint32_t _addr, uint64_t _tsc, uint32_t _latency) : type(_type), addr(_addr), latency(_latency), tsc(_tsc) {}
-   };
-   std::vector<TraceElement> trace;
-#endif
    // -------------------------------------------------------------------------------------
    Raid0 raid;
-   static const u64 CHUNK_SIZE = 1*1024*1024;
    // -------------------------------------------------------------------------------------
    //RemoteIoChannelClient remote_client;
    // -------------------------------------------------------------------------------------
   public:
-   Raid0Channel(TIoEnvironment& io_env, TIoChannel& io_channel, IoOptions io_options, u64 channelId, u64 totalChannels) // TODO
-      : IoChannel(io_env.deviceCount()), io_env(io_env), io_channel(io_channel), io_options(io_options), request_stack(io_options.iodepth), raid(io_env.deviceCount(), CHUNK_SIZE)
+   Raid0Channel(TIoEnvironment& io_env, TIoChannel& io_channel, IoOptions io_options, u64 channelId, u64 totalChannels, IoBufferPool& buffer_pool) // TODO
+      : IoChannel(io_env.deviceCount()), io_env(io_env), io_channel(io_channel), io_options(io_options), buffer_pool(buffer_pool), request_stack(io_options.iodepth), raid(io_env.deviceCount(), io_options.stripe_size)
    {
-#ifdef IO_TRACE_ON
-      trace.reserve(100e6);
-#endif
       for (int i = 0; i < request_stack.max_entries; i++) {
-         request_stack.requests[i].base.write_back_buffer = (char*)io_env.allocIoMemoryChecked(io_options.write_back_buffer_size, 512);
+         request_stack.requests[i].base.write_back_buffer = (char*)buffer_pool.alloc(io_options.write_back_buffer_size, 512);
       }
    };
    ~Raid0Channel() {
-      static std::atomic<int> traceThread = 0;
       for (int i = 0; i < request_stack.max_entries; i++) {
-          io_env.freeIoMemory(request_stack.requests[i].base.write_back_buffer, io_options.write_back_buffer_size);
-      }
-#ifdef IO_TRACE_ON
-      const int thread = traceThread.fetch_add(1);
-      std::cout << "write trace: " << trace.size() << std::endl;
-      std::ofstream outFile("trace" + std::to_string(thread) +".csv");
-      for (uint64_t i = 0; i < trace.size(); i++) {
-         auto& t  = trace[i];
-         outFile << i << "," << t.tsc << "," << (int)t.type << "," << t.addr << "," << t.latency<< std::endl;
+          buffer_pool.release(request_stack.requests[i].base.write_back_buffer);
       }
-      outFile.close();
-#endif
    };
    // -------------------------------------------------------------------------------------
    IoBaseRequest* getIoRequest() override { 
@@ -162,7 +140,7 @@ class Raid0Channel : public IoChannel
       while (request_stack.popFromSubmitStack(req)) {
          int device;
          u64 raidedOffset;
-         assert(req->base.len <= CHUNK_SIZE);
+         assert(req->base.len <= io_options.stripe_size);
          raid.calc(req->base.addr, device, raidedOffset);
          req->base.device = device;
          req->base.offset = raidedOffset;
@@ -170,14 +148,11 @@ class Raid0Channel : public IoChannel
          req->base.innerCallback.user_data2.val.ptr = this;
          req->base.innerCallback.callback = [](IoBaseRequest* req) {
             auto rr = reinterpret_cast<RaidRequest<TImplRequest>*>(req->innerCallback.user_data.val.ptr);
+            rr->base.stats.completion_time = readTSC();
             rr->base.user.callback(&rr->base);
             auto this_ptr = (Raid0Channel<TIoEnvironment, TIoChannel,TImplRequest>*)req->innerCallback.user_data2.val.ptr;
             auto ch = reinterpret_cast<Raid0Channel<TIoEnvironment, TIoChannel,TImplRequest>*>(this_ptr);
             /*COUNTERS_BLOCK()*/ { ch->counters.handleCompletedReq(*req); /*leanstore::SSDCounters::myCounters().polled[req->device]++;*/ }
-            rr->base.stats.completion_time = readTSC();
-#ifdef IO_TRACE_ON
-            this_ptr->trace.emplace_back((int)rr->base.type, rr->base.addr, nanoFromTsc(rr->base.stats.submit_time), tscDifferenceUs(readTSC(), rr->base.stats.submit_time));
-#endif
             if (!rr->base.reuse_request) {
                ch->request_stack.returnToFreeList(rr);
             }
@@ -222,150 +197,273 @@ class Raid0Channel : public IoChannel
    }
 };
 // -------------------------------------------------------------------------------------
-/*
+// RAID5 and RAID10: a user request fans out into two device I/Os. The user request itself
+// carries the data I/O, a companion request per slot carries the parity or mirror I/O.
+// RAID5 writes are read-modify-write: read old data and old parity, then write data and
+// new parity = old parity ^ old data ^ new data. The stripe row stays locked meanwhile.
 template <typename TIoEnvironment, typename TIoChannel, typename TImplRequest>
-class Raid5Channel : public IoChannel
+class RaidRedundantChannel : public IoChannel
 {
+   using Request = RaidRequest<TImplRequest>;
+   using ThisChannel = RaidRedundantChannel<TIoEnvironment, TIoChannel, TImplRequest>;
+   struct Op {
+      Request* second = nullptr;
+      int pending = 0;
+      bool rmwRead = false;
+      u64 row = 0;
+      // user view of the request, restored before the user callback
+      IoRequestType type = IoRequestType::Undefined;
+      char* data = nullptr;
+      bool write_back = false;
+      // old data followed by old/new parity
+      char* scratch = nullptr;
+      u64 scratchSize = 0;
+   };
    TIoEnvironment& io_env;
    TIoChannel& io_channel;
    IoOptions io_options;
-   RequestStack<RaidRequest<TImplRequest>> write_request_stack;
-   RequestStack<RaidRequest<TImplRequest>> read_request_stack;
-   // 
-   std::vector<u64> free_addrs;
-   u64 next_chunk;
-   u64 chunk_distance;
-   //
-   static const u64 CHUNK_SIZE = 64*1024;
-   Raid0 raid;
-   //
-   RemoteIoChannelClient remote_client;
+   StripeLocks& stripe_locks;
+   IoBufferPool& buffer_pool;
+   RequestStack<Request> request_stack;
+   std::unique_ptr<Request[]> second_requests;
+   std::unique_ptr<Op[]> ops;
+   std::deque<Request*> blocked;
+   const int deviceCnt;
+   int completedUser = 0;
+   bool pendingDeviceIos = false;
+   u64 readRoundRobin = 0;
+   // -------------------------------------------------------------------------------------
+   u64 userWrites = 0;
+   u64 userReads = 0;
+   u64 deviceWrites = 0;
+   u64 deviceReads = 0;
+   u64 stripeConflicts = 0;
+   // -------------------------------------------------------------------------------------
+   u64 slotOf(Request* req) { return req - request_stack.requests.get(); }
+   void ensureScratch(Op& op, u64 len) {
+      if (op.scratchSize >= len) {
+         return;
+      }
+      if (op.scratch) {
+         buffer_pool.release(op.scratch);
+      }
+      op.scratchSize = len;
+      op.scratch = (char*)buffer_pool.alloc(2 * op.scratchSize, 512);
+   }
+   void submitDevice(Request* req, u64 slot, IoRequestType type, char* buf) {
+      req->base.type = type;
+      req->base.data = buf;
+      req->base.write_back = false;
+      req->base.innerCallback.user_data.val.u = slot;
+      req->base.innerCallback.user_data2.val.ptr = this;
+      req->base.innerCallback.callback = [](IoBaseRequest* req) {
+         auto ch = reinterpret_cast<ThisChannel*>(req->innerCallback.user_data2.val.ptr);
+         ch->completeDevice(req->innerCallback.user_data.val.u);
+      };
+      if (type == IoRequestType::Write) {
+         deviceWrites++;
+      } else {
+         deviceReads++;
+      }
+      io_channel._push(req);
+   }
+   void start(Request* req) {
+      assert(req->base.len <= io_options.stripe_size);
+      const u64 slot = slotOf(req);
+      Op& op = ops[slot];
+      op.type = req->base.type;
+      op.data = req->base.data;
+      op.write_back = req->base.write_back;
+      char* buf = req->base.buffer();
+      Request* second = op.second;
+      second->base.len = req->base.len;
+      int device;
+      u64 offset;
+      if (io_options.raid == RaidLevel::Raid5) {
+         int parityDevice;
+         Raid5(deviceCnt, io_options.stripe_size).calc(req->base.addr, device, offset, parityDevice, op.row);
+         req->base.device = device;
+         req->base.offset = offset;
+         if (op.type == IoRequestType::Read) {
+            userReads++;
+            op.pending = 1;
+            submitDevice(req, slot, IoRequestType::Read, buf);
+         } else if (op.type == IoRequestType::Write) {
+            if (!stripe_locks.tryLock(op.row)) {
+               stripeConflicts++;
+               blocked.push_back(req);
+               return;
+            }
+            userWrites++;
+            ensureScratch(op, req->base.len);
+            second->base.device = parityDevice;
+            second->base.offset = offset;
+            op.rmwRead = true;
+            op.pending = 2;
+            submitDevice(req, slot, IoRequestType::Read, op.scratch);
+            submitDevice(second, slot, IoRequestType::Read, op.scratch + op.scratchSize);
+         } else {
+            throw std::logic_error("IoRequestType not supported by raid5");
+         }
+      } else {
+         int mirrorDevice;
+         Raid10(deviceCnt, io_options.stripe_size).calc(req->base.addr, device, offset, mirrorDevice);
+         req->base.offset = offset;
+         if (op.type == IoRequestType::Read) {
+            userReads++;
+            req->base.device = (readRoundRobin++ % 2 == 0) ? device : mirrorDevice;
+            op.pending = 1;
+            submitDevice(req, slot, IoRequestType::Read, buf);
+         } else if (op.type == IoRequestType::Write) {
+            userWrites++;
+            req->base.device = device;
+            second->base.device = mirrorDevice;
+            second->base.offset = offset;
+            op.pending = 2;
+            submitDevice(req, slot, IoRequestType::Write, buf);
+            submitDevice(second, slot, IoRequestType::Write, buf);
+         } else {
+            throw std::logic_error("IoRequestType not supported by raid10");
+         }
+      }
+   }
+   void completeDevice(u64 slot) {
+      Op& op = ops[slot];
+      Request* req = &request_stack.requests[slot];
+      if (--op.pending > 0) {
+         return;
+      }
+      if (op.rmwRead) {
+         char* newData = op.write_back ? req->base.write_back_buffer : op.data;
+         char* parity = op.scratch + op.scratchSize;
+         raidXor(parity, op.scratch, req->base.len);
+         raidXor(parity, newData, req->base.len);
+         op.rmwRead = false;
+         op.pending = 2;
+         submitDevice(req, slot, IoRequestType::Write, newData);
+         submitDevice(op.second, slot, IoRequestType::Write, parity);
+         pendingDeviceIos = true;
+         return;
+      }
+      if (io_options.raid == RaidLevel::Raid5 && op.type == IoRequestType::Write) {
+         stripe_locks.unlock(op.row);
+      }
+      req->base.type = op.type;
+      req->base.data = op.data;
+      req->base.write_back = op.write_back;
+      // the counters stamp the user request too, before the callback can reuse it
+      req->base.stats.completion_time = readTSC();
+      /*COUNTERS_BLOCK()*/ { counters.handleCompletedReq(req->base); }
+      req->base.user.callback(&req->base);
+      completedUser++;
+      if (!req->base.reuse_request) {
+         request_stack.returnToFreeList(req);
+      }
+   }
+   void retryBlocked() {
+      for (size_t i = blocked.size(); i > 0; i--) {
+         Request* req = blocked.front();
+         blocked.pop_front();
+         start(req);
+      }
+   }
   public:
-   Raid5Channel(TIoEnvironment& io_env, TIoChannel& io_channel, IoOptions io_options, u64 channelId, u64 totalChannels) 
-         : IoChannel(io_env.deviceCount()), io_env(io_env), io_channel(io_channel), io_options(io_options), write_request_stack(io_options.iodepth), read_request_stack(io_options.iodepth),
-            next_chunk(channelId), chunk_distance(totalChannels), raid(io_env.deviceCount(), CHUNK_SIZE)
+   RaidRedundantChannel(TIoEnvironment& io_env, TIoChannel& io_channel, IoOptions io_options, StripeLocks& stripe_locks, IoBufferPool& buffer_pool)
+      : IoChannel(io_env.deviceCount()), io_env(io_env), io_channel(io_channel), io_options(io_options), stripe_locks(stripe_locks),
+        buffer_pool(buffer_pool), request_stack(io_options.iodepth), deviceCnt(io_env.deviceCount())
    {
-      for (int i = 0; i < write_request_stack.max_entries; i++) {
-         write_request_stack.requests[i].base.write_back_buffer = (char*)io_env.allocIoMemoryChecked(io_options.write_back_buffer_size, 512);
-      }
-      for (int i = 0; i < read_request_stack.max_entries; i++) {
-         read_request_stack.requests[i].base.write_back_buffer = (char*)io_env.allocIoMemoryChecked(io_options.write_back_buffer_size, 512);
+      second_requests = std::make_unique<Request[]>(request_stack.max_entries);
+      ops = std::make_unique<Op[]>(request_stack.max_entries);
+      for (int i = 0; i < request_stack.max_entries; i++) {
+         request_stack.requests[i].base.write_back_buffer = (char*)buffer_pool.alloc(io_options.write_back_buffer_size, 512);
+         ops[i].second = &second_requests[i];
+         if (io_options.raid == RaidLevel::Raid5) {
+            ensureScratch(ops[i], io_options.write_back_buffer_size);
+         }
       }
    };
-   ~Raid5Channel() {
-      for (int i = 0; i < write_request_stack.max_entries; i++) {
-          io_env.freeIoMemory(write_request_stack.requests[i].base.write_back_buffer, io_options.write_back_buffer_size);
-      }
-      for (int i = 0; i < read_request_stack.max_entries; i++) {
-          io_env.freeIoMemory(read_request_stack.requests[i].base.write_back_buffer, io_options.write_back_buffer_size);
+   ~RaidRedundantChannel() {
+      for (int i = 0; i < request_stack.max_entries; i++) {
+         buffer_pool.release(request_stack.requests[i].base.write_back_buffer);
+         if (ops[i].scratch) {
+            buffer_pool.release(ops[i].scratch);
+         }
       }
    };
    // -------------------------------------------------------------------------------------
-   void _push(const IoBaseRequest& usr) override { 
-      RaidRequest<TImplRequest>* req = nullptr;
-      switch (usr.type) {
-         case IoRequestType::Write:
-            if (!write_request_stack.pushToSubmitStack(req)) {
-               throw std::logic_error("Cannot push more");
-            }
-            break;
-         case IoRequestType::Read:
-            if (!read_request_stack.pushToSubmitStack(req)) {
-               throw std::logic_error("Cannot push more");
-            }
-            break;
-         default:
-            throw std::logic_error("not implemented");
+   IoBaseRequest* getIoRequest() override {
+      Request* req = nullptr;
+      if (!request_stack.popFromFreeStack(req)) {
+         return nullptr;
       }
-      ensure(req);
-		req->base.stats.push_time = readTSC();
-      if (usr.type == IoRequestType::Write && usr.write_back) {
-         req->base.write_back = true;
-         assert(usr.len <= io_options.write_back_buffer_size);
-         std::memcpy(req->base.write_back_buffer, usr.data, usr.len);
+      return &req->base;
+   }
+   void pushIoRequest(IoBaseRequest* base_req) override {
+      const std::size_t offset = offsetof(Request, base);
+      Request* req = reinterpret_cast<Request*>(reinterpret_cast<char*>(base_req) - offset);
+      req->base.stats.push_time = readTSC();
+      if (req->base.type == IoRequestType::Write && req->base.write_back) {
+         assert(req->base.len <= io_options.write_back_buffer_size);
+         std::memcpy(req->base.write_back_buffer, req->base.data, req->base.len);
       }
-      req->base.copyFields(usr);
+      req->base.out_of_place_addr = req->base.addr;
+      request_stack.pushToSubmitStack(req);
+   }
+   int registerBuffers(std::vector<std::pair<void*, uint64_t>>& iovec) override {
+      return io_channel.registerBuffers(iovec);
    };
+   void _push(const IoBaseRequest& usr) override {
+      IoBaseRequest* req = getIoRequest();
+      if (!req) {
+         throw std::logic_error("Cannot push more: free: " + std::to_string(request_stack.free) + " pushed: " + std::to_string(request_stack.pushed)  + " max: " + std::to_string(request_stack.max_entries));
+      }
+      req->copyFields(usr);
+      pushIoRequest(req);
+   }
    int submitable() override {
-      return write_request_stack.submitStackSize() + read_request_stack.submitStackSize();
+      return request_stack.submitStackSize() + blocked.size();
    };
-   int _submit() override { 
-      // READ
-      RaidRequest<TImplRequest>* req;
-      while (read_request_stack.popFromSubmitStack(req)) {
-         int device;
-         u64 raidedOffset;
-         assert(req->base.len < CHUNK_SIZE);
-         raid.calc(req->base.addr, device, raidedOffset);
-         req->base.device = device;
-         req->base.offset = raidedOffset;
-         req->base.innerCallback.user_data.val.ptr = req;
-         req->base.innerCallback.user_data2.val.ptr = this;
-         req->base.innerCallback.callback = [](IoBaseRequest* req) {
-            auto rr = reinterpret_cast<RaidRequest<TImplRequest>*>(req->innerCallback.user_data.val.ptr);
-            rr->base.user.callback(&rr->base);
-            auto ch = reinterpret_cast<Raid5Channel<TIoEnvironment, TIoChannel,TImplRequest>*>(req->innerCallback.user_data2.val.ptr);
-            COUNTERS_BLOCK() { ch->counters.handleCompletedReq(*req); }
-            ch->read_request_stack.returnToFreeList(rr);
-         };
-         COUNTERS_BLOCK() { counters.handleSubmitReq(req->base); }
-         io_channel._push(req);
-      }
-      // WRITE
-      // look at all pushed requests,      RaidRequest<TImplRequest>* req;
-      int deviceCnt = io_env.deviceCount();
-      //ensure(write_request_stack.submitStackSize() % (deviceCnt - 1) == 0);
-      while (write_request_stack.submitStackSize() >= (deviceCnt - 1)) { // more requests than required for raid (minus parity)
-         std::vector<RaidRequest<TImplRequest>*> stripe = std::vector<RaidRequest<TImplRequest>*>(deviceCnt);
-         for (int i = 0; i < deviceCnt; i++) {
-            write_request_stack.popFromSubmitStack(stripe[i]);
-         }
-         // calculate raid, push them to below, submit
-         u64 raidedOffset;
-         int device;
-         // user io
-         for (int i = 0; i < deviceCnt - 1; i++) { 
-            // TODO do actual RAID
-            RaidRequest<TImplRequest>* req = stripe[i];
-            assert(req->base.len < CHUNK_SIZE);
-            raid.calc(req->base.addr, device, raidedOffset);
-            req->base.device = device;
-            req->base.offset = raidedOffset;
-            req->base.out_of_place_addr = req->base.addr;
-
-            req->base.innerCallback.user_data.val.ptr = req;
-            req->base.innerCallback.user_data2.val.ptr= this;
-            req->base.innerCallback.callback = [](IoBaseRequest* req) {
-               auto rr = reinterpret_cast<RaidRequest<TImplRequest>*>(req->innerCallback.user_data.val.ptr);
-               rr->base.user.callback(&rr->base);
-               auto ch = reinterpret_cast<Raid5Channel<TIoEnvironment, TIoChannel,TImplRequest>*>(req->innerCallback.user_data2.val.ptr);
-               COUNTERS_BLOCK() { ch->counters.handleCompletedReq(*req); }
-               ch->write_request_stack.returnToFreeList(rr);
-            };
-            COUNTERS_BLOCK() { counters.handleSubmitReq(req->base); }
-            io_channel._push(req);
-         }
+   int _submit() override {
+      retryBlocked();
+      Request* req;
+      while (request_stack.popFromSubmitStack(req)) {
+         req->base.stats.submit_time = readTSC();
+         start(req);
       }
       return io_channel._submit();
    };
-   int _poll(int min = 0) override { 
-      return  io_channel._poll(min);
+   int _poll(int min = 0) override {
+      io_channel._poll(min);
+      if (pendingDeviceIos || !blocked.empty()) {
+         pendingDeviceIos = false;
+         retryBlocked();
+         io_channel._submit();
+      }
+      int done = completedUser;
+      completedUser = 0;
+      return done;
+   };
+   void _printSpecializedCounters(std::ostream& ss) override {
+      ss << (io_options.raid == RaidLevel::Raid5 ? "raid5" : "raid10");
+      ss << " user w: " << userWrites << " r: " << userReads << " device w: " << deviceWrites << " r: " << deviceReads;
+      ss << " raid wa: " << (userWrites > 0 ? (double)deviceWrites / userWrites : 0) << " stripe conflicts: " << stripeConflicts << " ";
+      io_channel._printSpecializedCounters(ss);
    };
-   void _printSpecializedCounters(std::ostream& ss) override {io_channel._printSpecializedCounters(ss); };
-   int submitMin() override {
-      return io_env.deviceCount() - 1;
+   bool hasFreeIoRequests() override {
+      return !request_stack.full();
    };
    bool readStackFull() override {
-      return read_request_stack.full();
+      return request_stack.full();
    }
    bool writeStackFull() override {
-      return write_request_stack.full();
+      return request_stack.free < (request_stack.max_entries * 0.5);
    }
-   void registerRemoteChannel(RemoteIoChannel* rem) override {
-      remote_client.registerRemote(rem); 
+   void registerRemoteChannel(RemoteIoChannel*) override {
+   }
+   void pushBlocking(IoRequestType type, char* data, s64 addr, u64 len, bool write_back = false) override {
+      io_channel.pushBlocking(type, data, addr, len, write_back);
    }
 };
-*/
 // -------------------------------------------------------------------------------------
 class RaidEnvironment
 {
@@ -379,6 +477,7 @@ class RaidEnvironment
    // -------------------------------------------------------------------------------------
    virtual void freeIoMemory(void* ptr, size_t size = 0) = 0;
    void* allocIoMemoryChecked(size_t size, size_t align);
+   virtual IoBufferPool& bufferPool(int channel) = 0;
    // -------------------------------------------------------------------------------------
    virtual DeviceInformation getDeviceInfo() = 0;
   protected:
@@ -387,8 +486,29 @@ class RaidEnvironment
 template <typename TIoEnvironment, typename TIoChannel, typename TImplRequest>
 class RaidEnv : public RaidEnvironment {
    std::unique_ptr<TIoEnvironment> io_env;
+   StripeLocks stripe_locks;
+   std::vector<std::unique_ptr<IoBufferPool>> buffer_pools;
    std::vector<std::unique_ptr<IoChannel>> channels;
    IoOptions io_options;
+   // -------------------------------------------------------------------------------------
+   // hugepage backed, NUMA bound memory where the engine allows it, else the engine's DMA memory
+   std::unique_ptr<IoBufferPool> createBufferPool(int channel, int numaNode) {
+      IoBufferPool::SegmentAllocFun segmentAlloc;
+      IoBufferPool::SegmentFreeFun segmentFree;
+      if constexpr (requires(TIoEnvironment& env, u64& size) { env.allocPoolMemory(size, 0); }) {
+         segmentAlloc = [this, numaNode](u64& size) { return io_env->allocPoolMemory(size, numaNode); };
+         segmentFree = [this](void* ptr, u64 size) { io_env->freePoolMemory(ptr, size); };
+      } else {
+         segmentAlloc = [this](u64& size) { return io_env->allocIoMemory(size, IoBufferPool::SLICE_ALIGNMENT); };
+         segmentFree = [this](void* ptr, u64 size) { io_env->freeIoMemory(ptr, size); };
+      }
+      // registered once per segment, e.g. as io_uring fixed buffers
+      auto registerFun = [this, channel](void* ptr, u64 size) {
+         std::vector<std::pair<void*, uint64_t>> iovec{{ptr, size}};
+         io_env->getIoChannel(channel).registerBuffers(iovec);
+      };
+      return std::make_unique<IoBufferPool>(numaNode, segmentAlloc, segmentFree, registerFun);
+   }
   protected:
    void* allocIoMemory(size_t size, size_t align) override {
       return io_env->allocIoMemory(size, align);
@@ -397,18 +517,36 @@ class RaidEnv : public RaidEnvironment {
    RaidEnv(IoOptions options) : io_options(options) {
       io_env = std::unique_ptr<TIoEnvironment>(new TIoEnvironment());
       io_env->init(options);
+      const int devices = io_env->deviceCount();
+      ensurem(io_options.raid != RaidLevel::Raid5 || devices >= 3, "RAID5 needs at least 3 devices");
+      ensurem(io_options.raid != RaidLevel::Raid10 || devices % 2 == 0, "RAID10 needs an even number of devices");
       int io_env_max_channels = io_env->channelCount();
       int channelCount = options.channelCount > 0 ? options.channelCount : io_env_max_channels;
       channels.resize(channelCount);
       std::cout << "used channels: " << channels.size() << std::endl;
+      int deviceNode = -1;
+      if (devices > 0) {
+         deviceNode = topology::deviceNumaNode(io_env->getDeviceInfo().devices[0].name);
+      }
+      for (int i = 0; i < std::min(channelCount, io_env_max_channels); i++) {
+         // explicit node > node of the cpu the channel's thread is pinned to > device node
+         int numaNode = io_options.numa_node;
+         if (numaNode < 0 && i < (int)io_options.channel_cpus.size()) {
+            numaNode = topology::cpuNumaNode(io_options.channel_cpus[i]);
+         }
+         if (numaNode < 0) {
+            numaNode = deviceNode;
+         }
+         std::cout << "channel " << i << " io buffer numa node: " << numaNode << std::endl;
+         buffer_pools.push_back(createBufferPool(i, numaNode));
+      }
       for (int i = 0; i < channelCount; i++) {
          auto& ch = channels[i];
          if (i < io_env_max_channels) {
-            if (io_options.raid5) {
-               throw std::logic_error("not implemented");
-               //ch = std::unique_ptr<IoChannel>(new Raid5Channel<TIoEnvironment, TIoChannel, TImplRequest>(*io_env, io_env->getIoChannel(i), io_options, i, io_options.channelCount));
+            if (io_options.raid == RaidLevel::Raid5 || io_options.raid == RaidLevel::Raid10) {
+               ch = std::unique_ptr<IoChannel>(new RaidRedundantChannel<TIoEnvironment, TIoChannel, TImplRequest>(*io_env, io_env->getIoChannel(i), io_options, stripe_locks, *buffer_pools[i]));
             } else {
-               ch = std::unique_ptr<IoChannel>(new Raid0Channel<TIoEnvironment, TIoChannel, TImplRequest>(*io_env, io_env->getIoChannel(i), io_options, i, io_options.channelCount));
+               ch = std::unique_ptr<IoChannel>(new Raid0Channel<TIoEnvironment, TIoChannel, TImplRequest>(*io_env, io_env->getIoChannel(i), io_options, i, io_options.channelCount, *buffer_pools[i]));
             }
          } else {
              UnReachable();
@@ -443,10 +581,13 @@ class RaidEnv : public RaidEnvironment {
    void freeIoMemory(void* ptr, size_t size = 0) override {
       io_env->freeIoMemory(ptr, size);
    };
+   IoBufferPool& bufferPool(int channel) override {
+      return *buffer_pools.at(channel);
+   };
    // -------------------------------------------------------------------------------------
    u64 storageSize() override {
-      // TODO raided size...
-      return io_env->storageSize();
+      // usable size: per device size times the number of devices holding user data
+      return io_env->storageSize() * raidDataDevices(io_options.raid, io_env->deviceCount());
    };
    DeviceInformation getDeviceInfo() override {
       return io_env->getDeviceInfo();
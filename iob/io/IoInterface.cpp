@@ -5,6 +5,7 @@
 // -------------------------------------------------------------------------------------
 #include "impl/LibaioImpl.hpp"
 #include "impl/LiburingImpl.hpp"
+#include "impl/SimImpl.hpp"
 #include "impl/SpdkImpl.hpp"
 #include "impl/XnvmeImpl.hpp"
 // -------------------------------------------------------------------------------------
@@ -22,6 +23,8 @@ RaidEnvironment& IoInterface::initInstance(IoOptions ioOptions)
 #endif
    } else if (ioOptions.engine == "io_uring") {
       _instance = std::unique_ptr<RaidEnvironment>(new RaidEnv<LiburingEnv, LiburingChannel, LiburingIoRequest>(ioOptions));
+   } else if (ioOptions.engine == "sim") {
+      _instance = std::unique_ptr<RaidEnvironment>(new RaidEnv<SimEnv, SimChannel, SimIoRequest>(ioOptions));
 #ifdef LEANSTORE_INCLUDE_XNVME
    } else if (ioOptions.engine.find("xnvme") != string::npos) {
       _instance = std::unique_ptr<RaidEnvironment>(new RaidEnv<XnvmeEnv, XnvmeChannel, XnvmeRequest>(ioOptions));
@@ -50,6 +53,10 @@ void IoInterface::freeIoMemory(void* ptr, size_t size)
 {
    instance().freeIoMemory(ptr, size);
 }
+IoBufferPool& IoInterface::bufferPool(int channel)
+{
+   return instance().bufferPool(channel);
+}
 // -------------------------------------------------------------------------------------
 // -------------------------------------------------------------------------------------
 /*
@@ -33,6 +33,7 @@ class IoInterface
    static IoChannel& getIoChannel(int channel);
    static void* allocIoMemoryChecked(size_t size, size_t align);
    static void freeIoMemory(void* ptr, size_t size = 0);
+   static IoBufferPool& bufferPool(int channel);
 };
 // -------------------------------------------------------------------------------------
 }  // namespace mean
@@ -3,11 +3,16 @@
 #include "Units.hpp"
 // -------------------------------------------------------------------------------------
 #include <string>
-#include <exception>
+#include <vector>
+#include <stdexcept>
 // -------------------------------------------------------------------------------------
 namespace mean
 {
 // -------------------------------------------------------------------------------------
+enum class RaidLevel { Raid0, Raid5, Raid10 };
+// NVMe directive type used to pass write hints through passthrough writes
+enum class Placement { None = 0, Streams = 1, Fdp = 2 };
+// -------------------------------------------------------------------------------------
 struct IoOptions {
    std::string engine;
    std::string path;
@@ -22,8 +27,16 @@ struct IoOptions {
    bool ioUringFixedBuffers = false;
    int ioUringShareWq = 0;
    bool ioUringNVMePassthrough = false;
+   Placement placement = Placement::None;
+   int placement_ids = 8; // streams opened / placement handles of the namespace, hint % placement_ids is used
+   // -------------------------------------------------------------------------------------
+   u64 hugepage_size = 2 * MEBI; // backing pages of the I/O buffer pools, 0: transparent hugepages only
+   int numa_node = -1; // node of the I/O buffer pools, -1: node of the channel's cpu or the first device
+   std::vector<int> channel_cpus; // cpu the thread of channel i is pinned to, -1 or missing: not pinned
+   std::vector<int> sq_thread_cpus; // io_uring SQPOLL thread i, -1 or missing: not pinned
    // -------------------------------------------------------------------------------------
-   bool raid5 = false;
+   RaidLevel raid = RaidLevel::Raid0;
+   u64 stripe_size = 1 * MEBI;
    int channelCount = 0;
    // -------------------------------------------------------------------------------------
    IoOptions() {}
@@ -32,6 +45,24 @@ struct IoOptions {
    {
       if (async_batch_submit > iodepth)
          throw std::logic_error("iodepth must be higher than async_batch_submit");
+      if (stripe_size == 0 || stripe_size % 512 != 0)
+         throw std::logic_error("stripe_size must be a multiple of 512");
+      if (placement != Placement::None && (!ioUringNVMePassthrough || placement_ids <= 0))
+         throw std::logic_error("placement hints need NVMe passthrough and placement_ids > 0");
+   }
+   static RaidLevel raidLevelFromString(std::string s)
+   {
+      if (s == "0" || s == "raid0") return RaidLevel::Raid0;
+      if (s == "5" || s == "raid5") return RaidLevel::Raid5;
+      if (s == "10" || s == "raid10") return RaidLevel::Raid10;
+      throw std::logic_error("unknown raid level: " + s);
+   }
+   static Placement placementFromString(std::string s)
+   {
+      if (s == "none") return Placement::None;
+      if (s == "streams") return Placement::Streams;
+      if (s == "fdp") return Placement::Fdp;
+      throw std::logic_error("unknown placement: " + s);
    }
 };
 // -------------------------------------------------------------------------------------
@@ -0,0 +1,182 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include "IoRequest.hpp"
+#include "Time.hpp"
+#include "Units.hpp"
+#include "Exceptions.hpp"
+// -------------------------------------------------------------------------------------
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+// -------------------------------------------------------------------------------------
+namespace mean
+{
+// -------------------------------------------------------------------------------------
+// Streaming I/O trace: every worker thread pushes completed requests into its own
+// single producer / single consumer ring; a background thread drains all rings into
+// one binary file. If the writer falls behind, records are dropped and counted
+// instead of blocking the I/O path.
+//
+// File layout: IoTraceFileHeader followed by IoTraceRecords. Times are raw TSC values,
+// the header has the TSC base and rate to convert them (see iotrace/iotrace.cpp).
+// -------------------------------------------------------------------------------------
+struct IoTraceFileHeader {
+   static constexpr char MAGIC[8] = {'I', 'O', 'B', 'T', 'R', 'A', 'C', 'E'};
+   static constexpr u32 VERSION = 1;
+   char magic[8];
+   u32 version;
+   u32 recordSize;
+   u64 sampleEvery;
+   u64 baseTsc;
+   double tscPerNs;
+};
+struct IoTraceRecord {
+   u64 begin;  // tsc
+   u64 submit;
+   u64 end;
+   u64 addr;
+   u32 len;
+   u32 reqId;
+   u16 threadId;
+   u8 type;  // IoRequestType
+   u8 reserved[5];
+};
+static_assert(sizeof(IoTraceRecord) == 48);
+// -------------------------------------------------------------------------------------
+class IoTraceRing
+{
+   std::unique_ptr<IoTraceRecord[]> records;
+   const u64 mask;
+   alignas(64) std::atomic<u64> head = 0;  // written by the consumer
+   alignas(64) std::atomic<u64> tail = 0;  // written by the producer
+   u64 sampleEvery;
+   u64 seen = 0;
+   u64 dropped = 0;
+  public:
+   // capacity is rounded up to a power of two
+   IoTraceRing(u64 capacity, u64 sampleEvery)
+      : records(std::make_unique<IoTraceRecord[]>(std::bit_ceil(capacity))), mask(std::bit_ceil(capacity) - 1), sampleEvery(sampleEvery) {}
+   // producer
+   void push(u16 threadId, const IoBaseRequest& req)
+   {
+      if (seen++ % sampleEvery != 0) {
+         return;
+      }
+      const u64 t = tail.load(std::memory_order_relaxed);
+      if (t - head.load(std::memory_order_acquire) > mask) {
+         dropped++;
+         return;
+      }
+      auto& r = records[t & mask];
+      r.begin = req.stats.push_time;
+      r.submit = req.stats.submit_time;
+      r.end = req.stats.completion_time;
+      r.addr = req.addr;
+      r.len = req.len;
+      r.reqId = req.id;
+      r.threadId = threadId;
+      r.type = (u8)req.type;
+      tail.store(t + 1, std::memory_order_release);
+   }
+   // consumer, returns the number of records written to out
+   u64 drain(std::ostream& out)
+   {
+      const u64 h = head.load(std::memory_order_relaxed);
+      const u64 t = tail.load(std::memory_order_acquire);
+      if (t == h) {
+         return 0;
+      }
+      // at most two contiguous pieces
+      const u64 from = h & mask;
+      const u64 count = t - h;
+      const u64 first = std::min(count, mask + 1 - from);
+      out.write((const char*)&records[from], first * sizeof(IoTraceRecord));
+      if (count > first) {
+         out.write((const char*)&records[0], (count - first) * sizeof(IoTraceRecord));
+      }
+      head.store(t, std::memory_order_release);
+      return count;
+   }
+   u64 droppedRecords() const { return dropped; }
+};
+// -------------------------------------------------------------------------------------
+class IoTraceWriter
+{
+   std::vector<std::unique_ptr<IoTraceRing>> rings;
+   std::ofstream out;
+   std::thread writerThread;
+   std::atomic<bool> keepRunning = true;
+   u64 written = 0;
+   static inline std::unique_ptr<IoTraceWriter> globalWriter;
+
+   void writerLoop()
+   {
+      while (keepRunning) {
+         u64 n = 0;
+         for (auto& r : rings) {
+            n += r->drain(out);
+         }
+         written += n;
+         if (n == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+      }
+      for (auto& r : rings) {
+         written += r->drain(out);
+      }
+   }
+  public:
+   IoTraceWriter(std::string filename, int threads, u64 ringCapacity, double sampleRate)
+   {
+      ensurem(sampleRate > 0 && sampleRate <= 1, "IOTRACE_SAMPLE must be in (0, 1]");
+      const u64 sampleEvery = std::llround(1 / sampleRate);
+      for (int i = 0; i < threads; i++) {
+         rings.push_back(std::make_unique<IoTraceRing>(ringCapacity, sampleEvery));
+      }
+      out.open(filename, std::ios::binary | std::ios::trunc);
+      ensurem(out.good(), "could not open io trace file " + filename);
+      IoTraceFileHeader header;
+      std::memcpy(header.magic, IoTraceFileHeader::MAGIC, sizeof(header.magic));
+      header.version = IoTraceFileHeader::VERSION;
+      header.recordSize = sizeof(IoTraceRecord);
+      header.sampleEvery = sampleEvery;
+      header.baseTsc = readTSC();
+      header.tscPerNs = tscPerNs;
+      out.write((const char*)&header, sizeof(header));
+      writerThread = std::thread(&IoTraceWriter::writerLoop, this);
+   }
+   ~IoTraceWriter() { stop(); }
+   void stop()
+   {
+      if (!writerThread.joinable()) {
+         return;
+      }
+      keepRunning = false;
+      writerThread.join();
+      out.close();
+      u64 dropped = 0;
+      for (auto& r : rings) {
+         dropped += r->droppedRecords();
+      }
+      std::cout << "io trace: " << written << " records written, " << dropped << " dropped" << std::endl;
+   }
+   IoTraceRing& ring(int thread) { return *rings.at(thread); }
+   // -------------------------------------------------------------------------------------
+   static void startGlobal(std::string filename, int threads, u64 ringCapacity, double sampleRate)
+   {
+      globalWriter = std::make_unique<IoTraceWriter>(filename, threads, ringCapacity, sampleRate);
+   }
+   static IoTraceWriter* global() { return globalWriter.get(); }
+   static void stopGlobal() { globalWriter.reset(); }
+};
+// -------------------------------------------------------------------------------------
+}  // namespace mean
+// -------------------------------------------------------------------------------------
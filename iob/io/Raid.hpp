@@ -1,18 +1,53 @@
 #pragma once
 
+#include "IoOptions.hpp"
+
 #include <cassert>
 #include <cstdint>
 #include <functional>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <unordered_set>
 #include <vector>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+// XOR src into dst, used for RAID5 parity
+inline void raidXor(char* dst, const char* src, uint64_t len)
+{
+   uint64_t i = 0;
+#if defined(__AVX512F__)
+   for (; i + 64 <= len; i += 64) {
+      __m512i a = _mm512_loadu_si512((const void*)(dst + i));
+      __m512i b = _mm512_loadu_si512((const void*)(src + i));
+      _mm512_storeu_si512((void*)(dst + i), _mm512_xor_si512(a, b));
+   }
+#elif defined(__AVX2__)
+   for (; i + 32 <= len; i += 32) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a, b));
+   }
+#elif defined(__SSE2__)
+   for (; i + 16 <= len; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, b));
+   }
+#endif
+   for (; i < len; i++) {
+      dst[i] ^= src[i];
+   }
+}
 
 class Raid0
 {
    const int deviceCnt;
-   const int chunkSize;
+   const uint64_t chunkSize;
   public:
-   Raid0(int deviceCnt, int chunkSize) : deviceCnt(deviceCnt), chunkSize(chunkSize) {}
+   Raid0(int deviceCnt, uint64_t chunkSize) : deviceCnt(deviceCnt), chunkSize(chunkSize) {}
    void calc(uint64_t offset, int& deviceOut, uint64_t& offsetOut)
    {
       const uint64_t chunk = offset / chunkSize;
@@ -22,29 +57,91 @@ class Raid0
    }
 };
 
+// left-symmetric layout: parity rotates backwards over the devices, data starts right after parity
 class Raid5
 {
    const int deviceCnt;
-   const int chunkSize;
+   const uint64_t chunkSize;
   public:
-   Raid5(int deviceCnt, int chunkSize) : deviceCnt(deviceCnt), chunkSize(chunkSize) {}
+   Raid5(int deviceCnt, uint64_t chunkSize) : deviceCnt(deviceCnt), chunkSize(chunkSize) { assert(deviceCnt >= 3); }
    void calc(uint64_t offset, int& deviceOut, uint64_t& offsetOut)
+   {
+      int parityDevice;
+      uint64_t row;
+      calc(offset, deviceOut, offsetOut, parityDevice, row);
+   }
+   // parity lives at the same offset on parityOut, row identifies the stripe for locking
+   void calc(uint64_t offset, int& deviceOut, uint64_t& offsetOut, int& parityOut, uint64_t& rowOut)
    {
       const uint64_t chunk = offset / chunkSize;
       const uint64_t offsetInChunk = offset % chunkSize;
-      deviceOut = chunk % deviceCnt;
-      offsetOut = (chunk / deviceCnt) * chunkSize + offsetInChunk;  // / deviceCnt * lbasPerDevice + addrRemainder;
+      const uint64_t dataChunks = deviceCnt - 1;
+      rowOut = chunk / dataChunks;
+      parityOut = (deviceCnt - 1) - (rowOut % deviceCnt);
+      deviceOut = (parityOut + 1 + chunk % dataChunks) % deviceCnt;
+      offsetOut = rowOut * chunkSize + offsetInChunk;
+   }
+};
+
+// striped mirrors: device 2*i and 2*i+1 form a pair, chunks are striped over the pairs
+class Raid10
+{
+   const int deviceCnt;
+   const uint64_t chunkSize;
+  public:
+   Raid10(int deviceCnt, uint64_t chunkSize) : deviceCnt(deviceCnt), chunkSize(chunkSize) { assert(deviceCnt >= 2 && deviceCnt % 2 == 0); }
+   void calc(uint64_t offset, int& deviceOut, uint64_t& offsetOut)
+   {
+      int mirror;
+      calc(offset, deviceOut, offsetOut, mirror);
+   }
+   void calc(uint64_t offset, int& deviceOut, uint64_t& offsetOut, int& mirrorOut)
+   {
+      const uint64_t chunk = offset / chunkSize;
+      const uint64_t offsetInChunk = offset % chunkSize;
+      const uint64_t pairs = deviceCnt / 2;
+      deviceOut = (chunk % pairs) * 2;
+      mirrorOut = deviceOut + 1;
+      offsetOut = (chunk / pairs) * chunkSize + offsetInChunk;
+   }
+};
+
+inline int raidDataDevices(mean::RaidLevel level, int deviceCnt)
+{
+   switch (level) {
+      case mean::RaidLevel::Raid5: return deviceCnt - 1;
+      case mean::RaidLevel::Raid10: return deviceCnt / 2;
+      default: return deviceCnt;
+   }
+}
+
+// RAID5 read-modify-write must not interleave on the same stripe row, shared by all channels.
+class StripeLocks
+{
+   std::mutex mutex;
+   std::unordered_set<uint64_t> locked;
+  public:
+   bool tryLock(uint64_t row)
+   {
+      std::unique_lock<std::mutex> guard(mutex);
+      return locked.insert(row).second;
+   }
+   void unlock(uint64_t row)
+   {
+      std::unique_lock<std::mutex> guard(mutex);
+      locked.erase(row);
    }
 };
 
 template<typename DeviceType>
 class RaidController
 {
-   static constexpr int CHUNK_SIZE = 1 * 1024 * 1024;
    std::vector<std::string> devices;
    std::vector<DeviceType> fds;
+   const mean::RaidLevel level;
+   const uint64_t chunkSize;
   public:
-   RaidController(std::string connectionString)
+   RaidController(std::string connectionString, mean::RaidLevel level = mean::RaidLevel::Raid0, uint64_t chunkSize = 1 * 1024 * 1024) : level(level), chunkSize(chunkSize)
    {
       std::istringstream iss(connectionString);
       std::string device;
@@ -65,6 +162,15 @@ class RaidController
    DeviceType deviceTypeOrFd(int d) {
       return fds.at(d);
    }
+   DeviceType* devicePtr(int d) {
+      return &fds.at(d);
+   }
+   mean::RaidLevel raidLevel() {
+      return level;
+   }
+   uint64_t stripeSize() {
+      return chunkSize;
+   }
    void forEach(std::function<void (std::string& dev, DeviceType& fd)> fun)
    {
       const int size = devices.size();
@@ -72,12 +178,12 @@ class RaidController
          fun(devices[i], fds[i]);
       }
    }
-   // this functions assumes the request is smaller than CHUNK_SIZE,
+   // this functions assumes the request is smaller than the stripe size,
    // so use carefully
    /*
    std::tuple<DeviceType& deviceOut, uint64_t offsetOut> calc(uint64_t offset, uint64_t len) {
-      assert(len <= CHUNK_SIZE);
-      Raid0 raid(devices.size(), CHUNK_SIZE);
+      assert(len <= chunkSize);
+      Raid0 raid(devices.size(), chunkSize);
       uint64_t offsetOut;
       int deviceSelector;
       raid.calc(offset, deviceSelector, offsetOut);
@@ -86,26 +192,46 @@ class RaidController
    }*/
    void calc(uint64_t offset, uint64_t len, DeviceType*& deviceOut, uint64_t& offsetOut)
    {
-      assert(len <= CHUNK_SIZE);
-      Raid0 raid(devices.size(), CHUNK_SIZE);
+      assert(len <= chunkSize);
       int deviceSelector;
-      raid.calc(offset, deviceSelector, offsetOut);
+      switch (level) {
+         case mean::RaidLevel::Raid5: Raid5(devices.size(), chunkSize).calc(offset, deviceSelector, offsetOut); break;
+         case mean::RaidLevel::Raid10: Raid10(devices.size(), chunkSize).calc(offset, deviceSelector, offsetOut); break;
+         default: Raid0(devices.size(), chunkSize).calc(offset, deviceSelector, offsetOut);
+      }
       deviceOut = &fds[deviceSelector];
    }
+   // RAID5: parity location of the stripe that holds offset
+   void parity(uint64_t offset, DeviceType*& deviceOut, uint64_t& offsetOut)
+   {
+      assert(level == mean::RaidLevel::Raid5);
+      int device, parityDevice;
+      uint64_t row;
+      Raid5(devices.size(), chunkSize).calc(offset, device, offsetOut, parityDevice, row);
+      deviceOut = &fds[parityDevice];
+   }
+   // RAID10: second copy of offset
+   void mirror(uint64_t offset, DeviceType*& deviceOut, uint64_t& offsetOut)
+   {
+      assert(level == mean::RaidLevel::Raid10);
+      int device, mirrorDevice;
+      Raid10(devices.size(), chunkSize).calc(offset, device, offsetOut, mirrorDevice);
+      deviceOut = &fds[mirrorDevice];
+   }
    /*
    using SubmissionFun = std::function<void(char*, DeviceType&, uint64_t, uint64_t)>;
    void submitIos(char* buf, uint64_t offset, uint64_t len, SubmissionFun submission)
    {
-      Raid0 raid(devices.size(), CHUNK_SIZE);
+      Raid0 raid(devices.size(), chunkSize);
       int deviceSelector;
       uint64_t offsetOut;
       uint64_t remaining = len;
       do {
          raid.calc(offset, deviceSelector, offsetOut);
-         submission(buf, fds[deviceSelector], offsetOut, remaining > CHUNK_SIZE ? CHUNK_SIZE : remaining);
-         remaining -= CHUNK_SIZE;
-         offset += CHUNK_SIZE;
-         buf += CHUNK_SIZE;
+         submission(buf, fds[deviceSelector], offsetOut, remaining > chunkSize ? chunkSize : remaining);
+         remaining -= chunkSize;
+         offset += chunkSize;
+         buf += chunkSize;
          // remaining
       } while (remaining > 0);
    }
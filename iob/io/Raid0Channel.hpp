@@ -33,48 +33,22 @@ class Raid0Channel : public IoChannel {
    u64 pushedFromRemote = 0;
    u64 completed = 0;
    // ------------------------------------------------------------------------------------
-// #define IO_TRACE_ON
-#ifdef IO_TRACE_ON
-   struct TraceElement {
-      uint8_t type;
-      uint32_t addr;
-      uint32_t latency;
-      uint64_t tsc;
-      TraceElement(uint8_t _type, uint32_t _addr, uint64_t _tsc, uint32_t _latency) : type(_type), addr(_addr), latency(_latency), tsc(_tsc) {}
-   };
-   std::vector<TraceElement> trace;
-#endif
    // -------------------------------------------------------------------------------------
    Raid0 raid;
-   static const u64 CHUNK_SIZE = 1 * MEBI;
    // -------------------------------------------------------------------------------------
    // RemoteIoChannelClient remote_client;
    // -------------------------------------------------------------------------------------
  public:
    Raid0Channel(TIoEnvironment& io_env, TIoChannel& io_channel, IoOptions io_options, u64 channelId, u64 totalChannels) // TODO
-       : IoChannel(io_env.deviceCount()), io_env(io_env), io_channel(io_channel), io_options(io_options), request_stack(io_options.iodepth), raid(io_env.deviceCount(), CHUNK_SIZE) {
-#ifdef IO_TRACE_ON
-      trace.reserve(100e6);
-#endif
+       : IoChannel(io_env.deviceCount()), io_env(io_env), io_channel(io_channel), io_options(io_options), request_stack(io_options.iodepth), raid(io_env.deviceCount(), io_options.stripe_size) {
       for (int i = 0; i < request_stack.max_entries; i++) {
          request_stack.requests[i].base.write_back_buffer = (char*)io_env.allocIoMemoryChecked(io_options.write_back_buffer_size, 512);
       }
    };
    ~Raid0Channel() override {
-      static std::atomic<int> traceThread = 0;
       for (int i = 0; i < request_stack.max_entries; i++) {
          io_env.freeIoMemory(request_stack.requests[i].base.write_back_buffer, io_options.write_back_buffer_size);
       }
-#ifdef IO_TRACE_ON
-      const int thread = traceThread.fetch_add(1);
-      std::cout << "write trace: " << trace.size() << std::endl;
-      std::ofstream outFile("trace" + std::to_string(thread) + ".csv");
-      for (uint64_t i = 0; i < trace.size(); i++) {
-         auto& t = trace[i];
-         outFile << i << "," << t.tsc << "," << (int)t.type << "," << t.addr << "," << t.latency << std::endl;
-      }
-      outFile.close();
-#endif
    };
    // -------------------------------------------------------------------------------------
    IoBaseRequest* getIoRequest() override {
@@ -144,7 +118,7 @@ class Raid0Channel : public IoChannel {
       while (request_stack.popFromSubmitStack(req)) {
          int device;
          u64 raidedOffset;
-         assert(req->base.len <= CHUNK_SIZE);
+         assert(req->base.len <= io_options.stripe_size);
          raid.calc(req->base.addr, device, raidedOffset);
          req->base.device = device;
          req->base.offset = raidedOffset;
@@ -152,14 +126,11 @@ class Raid0Channel : public IoChannel {
          req->base.innerCallback.user_data2.val.ptr = this;
          req->base.innerCallback.callback = [](IoBaseRequest* req) {
             auto rr = reinterpret_cast<RaidRequest<TImplRequest>*>(req->innerCallback.user_data.val.ptr);
+            rr->base.stats.completion_time = readTSC();
             rr->base.user.callback(&rr->base);
             auto this_ptr = (Raid0Channel<TIoEnvironment, TIoChannel, TImplRequest>*)req->innerCallback.user_data2.val.ptr;
             auto ch = reinterpret_cast<Raid0Channel<TIoEnvironment, TIoChannel, TImplRequest>*>(this_ptr);
             /*COUNTERS_BLOCK()*/ { ch->counters.handleCompletedReq(*req); /*leanstore::SSDCounters::myCounters().polled[req->device]++;*/ }
-            rr->base.stats.completion_time = readTSC();
-#ifdef IO_TRACE_ON
-            this_ptr->trace.emplace_back((int)rr->base.type, rr->base.addr, nanoFromTsc(rr->base.stats.submit_time), tscDifferenceUs(readTSC(), rr->base.stats.submit_time));
-#endif
             if (!rr->base.reuse_request) {
                ch->request_stack.returnToFreeList(rr);
             }
@@ -0,0 +1,199 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include "Units.hpp"
+// -------------------------------------------------------------------------------------
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+// -------------------------------------------------------------------------------------
+namespace mean
+{
+// -------------------------------------------------------------------------------------
+// NUMA topology from sysfs. Everything returns -1 if unknown (no NUMA, regular files, ...).
+// -------------------------------------------------------------------------------------
+namespace topology
+{
+inline int readIntFile(const std::string& file)
+{
+   std::ifstream in(file);
+   int value = -1;
+   if (!(in >> value)) {
+      return -1;
+   }
+   return value;
+}
+// /dev/nvme0n1, /dev/ng0n1 or a symlink to them -> node of the PCIe device of controller nvme0
+inline int deviceNumaNode(const std::string& dev)
+{
+   std::error_code ec;
+   std::string path = std::filesystem::weakly_canonical(dev, ec).string();
+   if (ec) {
+      path = dev;
+   }
+   std::smatch m;
+   if (!std::regex_search(path, m, std::regex("/(nvme|ng)([0-9]+)"))) {
+      return -1;
+   }
+   return readIntFile("/sys/class/nvme/nvme" + m[2].str() + "/device/numa_node");
+}
+inline int cpuNumaNode(int cpu)
+{
+   if (cpu < 0) {
+      return -1;
+   }
+   std::error_code ec;
+   for (auto& entry : std::filesystem::directory_iterator("/sys/devices/system/cpu/cpu" + std::to_string(cpu), ec)) {
+      auto name = entry.path().filename().string();
+      if (name.rfind("node", 0) == 0) {
+         return std::stoi(name.substr(4));
+      }
+   }
+   return -1;
+}
+// "0-3,8,10-11" (sysfs cpulist format, also used for CPUS=)
+inline std::vector<int> parseCpuList(const std::string& list)
+{
+   std::vector<int> cpus;
+   std::stringstream ss(list);
+   std::string range;
+   while (std::getline(ss, range, ',')) {
+      if (range.empty()) {
+         continue;
+      }
+      auto dash = range.find('-');
+      int from = std::stoi(range.substr(0, dash));
+      int to = dash == std::string::npos ? from : std::stoi(range.substr(dash + 1));
+      for (int c = from; c <= to; c++) {
+         cpus.push_back(c);
+      }
+   }
+   return cpus;
+}
+inline std::vector<int> onlineCpus()
+{
+   std::ifstream in("/sys/devices/system/cpu/online");
+   std::string list;
+   if (in >> list) {
+      return parseCpuList(list);
+   }
+   std::vector<int> cpus;
+   for (unsigned c = 0; c < std::thread::hardware_concurrency(); c++) {
+      cpus.push_back(c);
+   }
+   return cpus;
+}
+// all online cpus if node is unknown
+inline std::vector<int> nodeCpus(int node)
+{
+   if (node < 0) {
+      return onlineCpus();
+   }
+   std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+   std::string list;
+   if (!(in >> list)) {
+      return onlineCpus();
+   }
+   return parseCpuList(list);
+}
+inline int currentNumaNode()
+{
+   unsigned cpu, node;
+   if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+      return -1;
+   }
+   return node;
+}
+// preferred (not strict) policy, so allocation falls back to other nodes instead of failing
+inline bool bindMemoryToNode(void* addr, size_t len, int node)
+{
+   if (node < 0 || node >= 64) {
+      return false;
+   }
+   constexpr int MPOL_PREFERRED_ = 1;
+   unsigned long nodemask = 1ul << node;
+   return syscall(SYS_mbind, addr, len, MPOL_PREFERRED_, &nodemask, sizeof(nodemask) * 8, 0) == 0;
+}
+// -------------------------------------------------------------------------------------
+// Thread placement: generator threads first, then SQPOLL threads, then the stats thread.
+// CPUS="auto" takes the cpus of the nodes the devices are attached to (in device order),
+// otherwise CPUS is an explicit cpu list. Empty: no pinning (-1 everywhere).
+// -------------------------------------------------------------------------------------
+struct CpuPlacement {
+   std::vector<int> workers;
+   std::vector<int> sqPoll;
+   int stats = -1;
+
+   static CpuPlacement plan(const std::string& cpuSpec, const std::vector<std::string>& devices, int workerCount, int sqPollCount)
+   {
+      CpuPlacement p;
+      p.workers.assign(workerCount, -1);
+      p.sqPoll.assign(sqPollCount, -1);
+      if (cpuSpec.empty() || cpuSpec == "none") {
+         return p;
+      }
+      std::vector<int> cpus;
+      if (cpuSpec == "auto") {
+         std::vector<int> nodes;
+         for (auto& dev : devices) {
+            int node = deviceNumaNode(dev);
+            if (std::find(nodes.begin(), nodes.end(), node) == nodes.end()) {
+               nodes.push_back(node);
+            }
+         }
+         if (nodes.empty()) {
+            nodes.push_back(-1);
+         }
+         // interleave the nodes, so threads are spread over all device-local sockets
+         std::vector<std::vector<int>> perNode;
+         for (int node : nodes) {
+            perNode.push_back(nodeCpus(node));
+         }
+         for (u64 i = 0; ; i++) {
+            bool any = false;
+            for (auto& nc : perNode) {
+               if (i < nc.size()) {
+                  if (std::find(cpus.begin(), cpus.end(), nc[i]) == cpus.end()) {
+                     cpus.push_back(nc[i]);
+                  }
+                  any = true;
+               }
+            }
+            if (!any) {
+               break;
+            }
+         }
+      } else {
+         cpus = parseCpuList(cpuSpec);
+      }
+      if (cpus.empty()) {
+         return p;
+      }
+      u64 next = 0;
+      auto take = [&]() { return cpus[next++ % cpus.size()]; };
+      for (auto& c : p.workers) {
+         c = take();
+      }
+      for (auto& c : p.sqPoll) {
+         c = take();
+      }
+      p.stats = take();
+      if ((u64)(workerCount + sqPollCount + 1) > cpus.size()) {
+         std::cout << "CPUS: only " << cpus.size() << " cpus for " << workerCount + sqPollCount + 1 << " threads, cpus are shared" << std::endl;
+      }
+      return p;
+   }
+};
+// -------------------------------------------------------------------------------------
+}  // namespace topology
+// -------------------------------------------------------------------------------------
+}  // namespace mean
+// -------------------------------------------------------------------------------------
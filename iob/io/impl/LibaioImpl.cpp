@@ -7,6 +7,7 @@
 #include <linux/fs.h>
 #include <sys/ioctl.h>
 #include <cassert>
+#include <cstdlib>
 #include <filesystem>
 #include <regex>
 #include <libaio.h>
@@ -47,7 +48,7 @@ std::string fileToNGDevice(std::string dev) {
 void LinuxBaseEnv::init(IoOptions ioOpts)
 {
    this->ioOptions = ioOpts;
-   raidCtl = std::make_unique<RaidController<int>>(ioOptions.path);
+   raidCtl = std::make_unique<RaidController<int>>(ioOptions.path, ioOptions.raid, ioOptions.stripe_size);
    raidCtl->forEach([this](std::string& dev, int& fd) {
       int flags = O_RDWR | O_NOATIME;
       if (!ioOptions.ioUringNVMePassthrough) {
@@ -145,22 +146,53 @@ void LinuxBaseEnv::freeIoMemory(void* ptr, size_t size)
    munmap(ptr, size);
    // std::free(ptr);
 }
+void* LinuxBaseEnv::allocPoolMemory(u64& size, int numaNode)
+{
+   return HugePageMemory::alloc(size, ioOptions.hugepage_size, numaNode);
+}
+void LinuxBaseEnv::freePoolMemory(void* ptr, u64 size)
+{
+   HugePageMemory::free(ptr, size);
+}
 void LinuxBaseChannel::pushBlocking(IoRequestType type, char* data, s64 addr, u64 len, [[maybe_unused]] bool write_back)
 {
 	int* fd;
 	u64 raidedOffset;
 	raidCtl.calc(addr, len, fd, raidedOffset);
+   auto blockingIo = [len](bool write, int fd, char* buf, u64 offset) {
+      s64 ok = write ? pwrite(fd, buf, len, offset) : pread(fd, buf, len, offset);
+      posix_check(ok);
+      ensurem(ok == (s64)len, "I/O error: " + to_string(ok) + " (expected: " + to_string(len) + ")");
+   };
    switch (type) {
       case IoRequestType::Read: {
-         s64 ok = pread(*fd, data, len, raidedOffset);
-         posix_check(ok);
-         ensurem(ok == (s64)len, "I/O error: " + to_string(ok) + " (expected: " + to_string(len) + ")");
+         blockingIo(false, *fd, data, raidedOffset);
          break;
       }
       case IoRequestType::Write: {
-         s64 ok = pwrite(*fd, data, len, raidedOffset);
-         posix_check(ok);
-         ensurem(ok == (s64)len, "I/O error: " + to_string(ok) + " (expected: " + to_string(len) + ")");
+         if (raidCtl.raidLevel() == RaidLevel::Raid5) {
+            // read-modify-write: new parity = old parity ^ old data ^ new data
+            int* parityFd;
+            u64 parityOffset;
+            raidCtl.parity(addr, parityFd, parityOffset);
+            std::unique_ptr<char, decltype(&std::free)> old((char*)std::aligned_alloc(512, 2 * len), &std::free);
+            char* oldData = old.get();
+            char* parity = old.get() + len;
+            blockingIo(false, *fd, oldData, raidedOffset);
+            blockingIo(false, *parityFd, parity, parityOffset);
+            raidXor(parity, oldData, len);
+            raidXor(parity, data, len);
+            blockingIo(true, *fd, data, raidedOffset);
+            blockingIo(true, *parityFd, parity, parityOffset);
+         } else {
+            blockingIo(true, *fd, data, raidedOffset);
+            if (raidCtl.raidLevel() == RaidLevel::Raid10) {
+               int* mirrorFd;
+               u64 mirrorOffset;
+               raidCtl.mirror(addr, mirrorFd, mirrorOffset);
+               blockingIo(true, *mirrorFd, data, mirrorOffset);
+            }
+         }
          break;
       }
       default:
@@ -3,6 +3,7 @@
 #include "../IoAbstraction.hpp"
 #include "../Raid.hpp"
 #include "../RequestStack.hpp"
+#include "../BufferPool.hpp"
 // -------------------------------------------------------------------------------------
 #include <fcntl.h>
 #include <libaio.h>
@@ -37,6 +38,8 @@ public:
    virtual void* allocIoMemory(size_t size, size_t align);
    void* allocIoMemoryChecked(size_t size, size_t align);
    virtual void freeIoMemory(void* ptr, size_t size = 0);
+   void* allocPoolMemory(u64& size, int numaNode);
+   void freePoolMemory(void* ptr, u64 size);
    DeviceInformation getDeviceInfo();
 };
 class LinuxBaseChannel {
@@ -108,6 +108,13 @@ LiburingChannel::LiburingChannel(RaidController<int>& raidCtl, IoOptions ioOptio
       iouParameters.flags |= IORING_SETUP_ATTACH_WQ;
       // round robin the wq's
       iouParameters.wq_fd = dynamic_cast<LiburingChannel*>(env.channels[ env.channels.size() % ioOptions.ioUringShareWq ].get())->ring.ring_fd;
+   } else if (ioOptions.ioUringShareWq > 0) {
+      // this ring creates its own SQPOLL thread
+      const unsigned sqThread = env.channels.size();
+      if (sqThread < ioOptions.sq_thread_cpus.size() && ioOptions.sq_thread_cpus[sqThread] >= 0) {
+         iouParameters.flags |= IORING_SETUP_SQ_AFF;
+         iouParameters.sq_thread_cpu = ioOptions.sq_thread_cpus[sqThread];
+      }
    }
    std::cout << "io_uring parameters: sq_entries: " << iouParameters.sq_entries << " cq_entries: " << iouParameters.cq_entries 
       << " flags: " << iouParameters.flags << " sq_thread_cpu: " << iouParameters.sq_thread_cpu << " sq_thread_idle: " << iouParameters.sq_thread_idle 
@@ -135,17 +142,39 @@ LiburingChannel::LiburingChannel(RaidController<int>& raidCtl, IoOptions ioOptio
    request_stack.reserve(ioOptions.iodepth);
 }
 int LiburingChannel::registerBuffers(std::vector<std::pair<void*, uint64_t>>& iovec_pairs) {
-   std::vector<iovec> iovecs;
-   iovecs.reserve(iovec_pairs.size());
+   if (!ioOptions.ioUringFixedBuffers) {
+      return 0;
+   }
+   if (!fixedBufferTableRegistered) {
+      // sparse table so buffer pool segments can be added one by one
+      int ret = io_uring_register_buffers_sparse(&ring, MAX_FIXED_BUFFERS);
+      posix_check(ret == 0, "io_uring_register_buffers_sparse failed: ret: " + to_string(ret));
+      fixedBufferTableRegistered = true;
+   }
    for (auto iovp: iovec_pairs) {
+      if (fixedBuffers.size() >= MAX_FIXED_BUFFERS || iovp.second > GIBI) {
+         std::cout << "io_uring: buffer not registered, table full or larger than 1 GiB" << std::endl;
+         continue;
+      }
       iovec v;
       v.iov_base = iovp.first;
       v.iov_len = iovp.second;
-      iovecs.push_back(v);
+      int ret = io_uring_register_buffers_update_tag(&ring, fixedBuffers.size(), &v, nullptr, 1);
+      if (ret < 0) {
+         std::cout << "io_uring: io_uring_register_buffers_update_tag failed: " << ret << " (RLIMIT_MEMLOCK?)" << std::endl;
+         continue;
+      }
+      fixedBuffers.emplace_back((char*)iovp.first, iovp.second);
    }
-   int ret = io_uring_register_buffers(&ring, iovecs.data(), iovecs.size());
-   posix_check(ret == 0, "io_uring_register_buffers failed: ret: " + to_string(ret) + " <= if it is twentytwo it could be because too many buffers were added (limit right tow is 16k)");
-   return  0;
+   return 0;
+}
+int LiburingChannel::fixedBufferIndex(char* buf, u64 len) {
+   for (unsigned i = 0; i < fixedBuffers.size(); i++) {
+      if (buf >= fixedBuffers[i].first && buf + len <= fixedBuffers[i].first + fixedBuffers[i].second) {
+         return i;
+      }
+   }
+   return -1;
 }
 // -------------------------------------------------------------------------------------
 LiburingChannel::~LiburingChannel()
@@ -179,7 +208,7 @@ static void print_sqe(struct io_uring_sqe *sqe) {
           cmd->opcode, cmd->flags, cmd->rsvd1, cmd->nsid, cmd->cdw2, cmd->cdw3, cmd->metadata, cmd->addr, cmd->metadata_len, cmd->data_len, cmd->cdw10, cmd->cdw11, cmd->cdw12, cmd->cdw13, cmd->cdw14, cmd->cdw15, cmd->timeout_ms, cmd->rsvd2);
 }
 // -------------------------------------------------------------------------------------
-void prep_uring_cmd(uint8_t opcode, struct io_uring_sqe* sqe, int fd, struct iovec* iov, uint64_t slba, uint64_t nlb) {
+void prep_uring_cmd(uint8_t opcode, struct io_uring_sqe* sqe, int fd, struct iovec* iov, uint64_t slba, uint64_t nlb, Placement placement = Placement::None, uint16_t dspec = 0) {
    sqe->opcode = IORING_OP_URING_CMD;
    sqe->fd = fd;
    sqe->flags = 0;
@@ -196,6 +225,15 @@ void prep_uring_cmd(uint8_t opcode, struct io_uring_sqe* sqe, int fd, struct iov
    cmd->nsid = 1; // TODO
    cmd->opcode = opcode;
    cmd->cdw13 = 1 << 6; // DSM Sequential Request
+   if (placement != Placement::None) {
+      cmd->cdw12 |= (uint32_t)placement << 20; // DTYPE: 1 streams, 2 data placement (FDP)
+      cmd->cdw13 |= (uint32_t)dspec << 16; // DSPEC: stream id / placement id
+   }
+}
+// -------------------------------------------------------------------------------------
+// stream ids start at 1, FDP placement handles at 0
+static uint16_t placementDspec(const IoOptions& ioOptions, uint8_t hint) {
+   return hint % ioOptions.placement_ids + (ioOptions.placement == Placement::Streams ? 1 : 0);
 }
 // -------------------------------------------------------------------------------------
 int LiburingChannel::_submit()
@@ -211,9 +249,8 @@ int LiburingChannel::_submit()
       req->impl.iov.iov_len = req->base.len;
       switch (req->base.type) {
          case IoRequestType::Write: {
-            int* fd;
-            u64 raidedOffset;
-            raidCtl.calc(req->base.addr, req->base.len, fd, raidedOffset);
+            int* fd = raidCtl.devicePtr(req->base.device);
+            u64 raidedOffset = req->base.offset;
             auto dataBuf = req->base.data;
             if (req->base.write_back) {
                assert(req->base.len <= ioOptions.write_back_buffer_size);
@@ -224,8 +261,13 @@ int LiburingChannel::_submit()
             assert((uintptr_t)req->base.data % 512 == 0);
             // io_uring_prep_write(sqe, fd, dataBuf, req->base.len, req->base.addr);
             // std::cout << "write: buf: " << sqe->addr << " len: " << sqe->len << " addr: " << sqe->off << std::endl;
+            const int fixedIdx = fixedBufferIndex(dataBuf, req->base.len);
             if (ioOptions.ioUringNVMePassthrough) {
-               prep_uring_cmd(nvme_cmd_write, sqe, *fd, &req->impl.iov, raidedOffset / lba_sz, req->impl.iov.iov_len/lba_sz);
+               const bool hinted = req->base.hint != (uint8_t)-1 && ioOptions.placement != Placement::None;
+               prep_uring_cmd(nvme_cmd_write, sqe, *fd, &req->impl.iov, raidedOffset / lba_sz, req->impl.iov.iov_len/lba_sz,
+                              hinted ? ioOptions.placement : Placement::None, hinted ? placementDspec(ioOptions, req->base.hint) : 0);
+            } else if (fixedIdx >= 0) {
+               io_uring_prep_write_fixed(sqe, *fd, dataBuf, req->base.len, raidedOffset, fixedIdx);
             } else {
                io_uring_prep_writev(sqe, *fd, &req->impl.iov, 1, raidedOffset);
             }
@@ -233,14 +275,16 @@ int LiburingChannel::_submit()
             break;
          }
          case IoRequestType::Read: {
-            int* fd;
-            u64 raidedOffset;
-            raidCtl.calc(req->base.addr, req->base.len, fd, raidedOffset);
+            int* fd = raidCtl.devicePtr(req->base.device);
+            u64 raidedOffset = req->base.offset;
             assert((uintptr_t)req->base.data % 512 == 0);
             // io_uring_prep_read(sqe, fd, req->base.data, req->base.len, req->base.addr);
             // std::cout << "read buf: " << sqe->addr << " len: " << sqe->len << " off: " << sqe->off << std::endl;
+            const int fixedIdx = fixedBufferIndex(req->base.data, req->base.len);
             if (ioOptions.ioUringNVMePassthrough) {
                prep_uring_cmd(nvme_cmd_read, sqe, *fd, &req->impl.iov, raidedOffset / lba_sz, req->impl.iov.iov_len/lba_sz);
+            } else if (fixedIdx >= 0) {
+               io_uring_prep_read_fixed(sqe, *fd, req->base.data, req->base.len, raidedOffset, fixedIdx);
             } else {
                io_uring_prep_readv(sqe, *fd, &req->impl.iov, 1, raidedOffset);
             }
@@ -249,9 +293,8 @@ int LiburingChannel::_submit()
             break;
          }
          case IoRequestType::Trim: {
-            int* fd;
-            u64 raidedOffset;
-            raidCtl.calc(req->base.addr, req->base.len, fd, raidedOffset);
+            [[maybe_unused]] int* fd = raidCtl.devicePtr(req->base.device);
+            [[maybe_unused]] u64 raidedOffset = req->base.offset;
             assert((uintptr_t)req->base.data % 512 == 0);
             if (ioOptions.ioUringNVMePassthrough) {
                throw std::logic_error("IoRequestType not implemented when using passthrough");
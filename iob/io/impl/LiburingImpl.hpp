@@ -34,6 +34,11 @@ class LiburingChannel : public LinuxBaseChannel
    int outstanding = 0;
    int nothingPolledStarving = 0;
    int lba_sz = -1;
+   // registered buffer pool segments, index in the vector is the fixed buffer index
+   static constexpr unsigned MAX_FIXED_BUFFERS = 64;
+   bool fixedBufferTableRegistered = false;
+   std::vector<std::pair<char*, u64>> fixedBuffers;
+   int fixedBufferIndex(char* buf, u64 len);
 public:
    LiburingChannel(RaidController<int>& raidCtl, IoOptions ioOptions, LiburingEnv& env);
    ~LiburingChannel();
@@ -3,6 +3,7 @@
 
 #include "Units.hpp"
 #include "../IoInterface.hpp"
+#include "SimImpl.hpp"
 
 #include <libnvme.h>
 #include <nvme/types.h>
@@ -70,10 +71,24 @@ class NvmeLog {
    }
 public:
    void loadOCPSmartLog() {
+      if (SimEnv::active()) {
+         loadSimSmartLog(SimEnv::active()->smartLog(0));
+         return;
+      }
       int fd = IoInterface::instance().getDeviceInfo().devices[0].fd;
       int ret = nvme_get_log_simple(fd, (nvme_cmd_get_log_lid)C0_SMART_CLOUD_ATTR_OPCODE, C0_SMART_CLOUD_ATTR_LEN, &log_data);
       ocpSupported = (ret == 0); // ocp not supported
    }
+   // IOENGINE=sim: the same fields, filled from the emulated device
+   void loadSimSmartLog(const SimEnv::SmartLog& sim) {
+      log_data.fill(0);
+      *(uint64_t*)&log_data[SCAO_PMUW] = toBigEndian((uint64_t)sim.physicalBytesWritten);
+      *(uint64_t*)&log_data[SCAO_PMUR] = toBigEndian((uint64_t)sim.physicalBytesRead);
+      *(uint32_t*)&log_data[SCAO_MXUDEC] = toBigEndian((uint32_t)sim.maxEraseCount);
+      *(uint32_t*)&log_data[SCAO_MNUDEC] = toBigEndian((uint32_t)sim.minEraseCount);
+      log_data[SCAO_PFB] = sim.percentFreeBlocks;
+      ocpSupported = true;
+   }
    uint64_t physicalMediaUnitsWrittenBytes() {
       ensure(!ocpSupported || toBigEndian(*(uint64_t *)&log_data[SCAO_PMUW + 8] & 0xFFFFFFFFFFFFFFFF) == 0);
       return (toBigEndian(*(uint64_t *)&log_data[SCAO_PMUW] & 0xFFFFFFFFFFFFFFFF));
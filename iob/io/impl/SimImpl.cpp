@@ -0,0 +1,274 @@
+#include "SimImpl.hpp"
+// -------------------------------------------------------------------------------------
+#include "Env.hpp"
+#include "../../../sim/SSD.hpp"
+#include "../../../sim/Timing.hpp"
+#include "../../../sim/Greedy.hpp"
+#include "../../../sim/Generational.hpp"
+#include "../../../sim/TwoR.hpp"
+// -------------------------------------------------------------------------------------
+#include <sys/mman.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+// -------------------------------------------------------------------------------------
+namespace mean
+{
+// -------------------------------------------------------------------------------------
+// Device: SSD model, GC policy, timing model and the page contents
+// -------------------------------------------------------------------------------------
+static u64 hostNanos()
+{
+   static const auto start = std::chrono::steady_clock::now();
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+class SimDevice
+{
+   std::mutex mutex;
+   SSD ssd;
+   TimingModel timing;
+   const bool timed;
+   std::shared_ptr<void> gc;
+   std::function<void(uint64_t, uint8_t)> gcWritePage;
+   std::function<uint64_t()> gcFreeBlocks;
+   std::string gcName;
+   char* data = nullptr;
+   u64 dataSize = 0;
+
+   template <typename GCAlgo>
+   void useGc(std::shared_ptr<GCAlgo> p)
+   {
+      gc = p;
+      gcName = p->name();
+      gcWritePage = [p](uint64_t page, uint8_t hint) {
+         if constexpr (requires { p->writePage(page, hint); }) {
+            p->writePage(page, hint);
+         } else {
+            p->writePage(page);
+         }
+      };
+      gcFreeBlocks = [p]() { return p->freeBlockCnt(); };
+   }
+
+  public:
+   // SIM_CAPACITY, SIM_ERASE, SIM_PAGE, SIM_FILL: like CAPACITY, ERASE, PAGE, SSDFILL of sim
+   // SIM_GC: greedy, greedy-k<k>, greedy-s2r, 2r-*, gen
+   SimDevice()
+      : ssd(getBytesFromString(getEnv("SIM_CAPACITY", "16G")), getBytesFromString(getEnv("SIM_ERASE", "8M")),
+            getBytesFromString(getEnv("SIM_PAGE", "4K")), getEnv("SIM_FILL", 0.875f)),
+        timing(ssd, TimingModel::Config::fromEnv(ssd.pageSize)),
+        timed(getEnv("SIM_TIMING", 1.0f) > 0)
+   {
+      const std::string algo = getEnv("SIM_GC", "greedy");
+      if (algo == "greedy") {
+         useGc(std::make_shared<GreedyGC>(ssd));
+      } else if (algo.starts_with("greedy-k")) {
+         useGc(std::make_shared<GreedyGC>(ssd, std::stoi(algo.substr(8))));
+      } else if (algo == "greedy-s2r") {
+         useGc(std::make_shared<GreedyGC>(ssd, 0, true));
+      } else if (algo.starts_with("2r")) {
+         useGc(std::make_shared<TwoR>(ssd, algo));
+      } else if (algo == "gen") {
+         useGc(std::make_shared<GenerationalGC>(ssd));
+      } else {
+         throw std::logic_error("SIM_GC not supported: " + algo);
+      }
+      if (timed) {
+         ssd.setMediaHook([this](SSD::MediaOp op, uint64_t physAddr) { timing.submit(op, physAddr); });
+      }
+      if (getEnv("SIM_DATA", 1.0f) > 0) {
+         // only the pages written are backed by memory
+         dataSize = ssd.logicalPages * ssd.pageSize;
+         data = (char*)mmap(NULL, dataSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+         posix_check(data != MAP_FAILED, "SIM_DATA: could not map " + std::to_string(dataSize) + " bytes");
+      }
+   }
+   ~SimDevice()
+   {
+      ssd.setMediaHook(nullptr);
+      if (data) {
+         munmap(data, dataSize);
+      }
+   }
+   u64 size() const { return ssd.logicalPages * ssd.pageSize; }
+   std::string name() const { return gcName; }
+   // executes the I/O on the model, returns its latency in ns
+   u64 io(IoRequestType type, char* buf, u64 offset, u64 len, uint8_t hint)
+   {
+      if (offset % ssd.pageSize != 0 || len % ssd.pageSize != 0 || offset + len > size()) {
+         throw std::logic_error("sim: I/O not page aligned or out of range, offset: " + std::to_string(offset) + " len: " + std::to_string(len));
+      }
+      std::unique_lock<std::mutex> guard(mutex);
+      if (timed) {
+         timing.beginHostOpAt(hostNanos());
+      }
+      for (u64 page = offset / ssd.pageSize; page < (offset + len) / ssd.pageSize; page++) {
+         switch (type) {
+            case IoRequestType::Write: gcWritePage(page, hint); break;
+            case IoRequestType::Read: ssd.readPage(page); break;
+            default: throw std::logic_error("sim: IoRequestType not supported");
+         }
+      }
+      if (data) {
+         if (type == IoRequestType::Write) {
+            std::memcpy(data + offset, buf, len);
+         } else {
+            std::memcpy(buf, data + offset, len);
+         }
+      } else if (type == IoRequestType::Read) {
+         std::memset(buf, 0, len);
+      }
+      return timed ? timing.endHostOp() : 0;
+   }
+   SimEnv::SmartLog smartLog()
+   {
+      std::unique_lock<std::mutex> guard(mutex);
+      SimEnv::SmartLog log;
+      log.physicalBytesWritten = ssd.physWrites() * ssd.pageSize;
+      log.physicalBytesRead = (ssd.hostReads() - ssd.bufferReadHits() + ssd.gcReads()) * ssd.pageSize;
+      const auto erases = ssd.eraseCountStats();
+      log.maxEraseCount = erases.max;
+      log.minEraseCount = erases.min;
+      log.percentFreeBlocks = gcFreeBlocks() * 100 / ssd.zones;
+      return log;
+   }
+};
+// -------------------------------------------------------------------------------------
+// Env
+// -------------------------------------------------------------------------------------
+SimEnv* SimEnv::_active = nullptr;
+SimEnv::SimEnv() {}
+SimEnv::~SimEnv()
+{
+   channels.clear();
+   devices.clear();
+   if (_active == this) {
+      _active = nullptr;
+   }
+}
+void SimEnv::init(IoOptions options)
+{
+   ioOptions = options;
+   ensurem(ioOptions.raid == RaidLevel::Raid0, "IOENGINE=sim supports RAID0 only");
+   raidCtl = std::make_unique<RaidController<int>>(ioOptions.path, ioOptions.raid, ioOptions.stripe_size);
+   int id = 0;
+   raidCtl->forEach([&](std::string& dev, int& fd) {
+      fd = id++;
+      devices.push_back(std::make_unique<SimDevice>());
+      std::cout << "emulated: " << dev << " size: " << devices.back()->size() << " gc: " << devices.back()->name() << std::endl;
+   });
+   _active = this;
+}
+int SimEnv::deviceCount()
+{
+   return raidCtl->deviceCount();
+}
+int SimEnv::channelCount()
+{
+   return 10000;
+}
+u64 SimEnv::storageSize()
+{
+   u64 size = devices.at(0)->size();
+   for (auto& d : devices) {
+      size = std::min(size, d->size());
+   }
+   return size;
+}
+SimChannel& SimEnv::getIoChannel(int channel)
+{
+   auto ch = channels.find(channel);
+   if (ch == channels.end()) {
+      ch = channels.insert({channel, std::make_unique<SimChannel>(*raidCtl, devices, ioOptions)}).first;
+   }
+   return *ch->second;
+}
+void* SimEnv::allocIoMemory(size_t size, [[maybe_unused]] size_t align)
+{
+   void* bfs = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   madvise(bfs, size, MADV_HUGEPAGE);
+   return bfs;
+}
+void SimEnv::freeIoMemory(void* ptr, size_t size)
+{
+   munmap(ptr, size);
+}
+void* SimEnv::allocPoolMemory(u64& size, int numaNode)
+{
+   return HugePageMemory::alloc(size, ioOptions.hugepage_size, numaNode);
+}
+void SimEnv::freePoolMemory(void* ptr, u64 size)
+{
+   HugePageMemory::free(ptr, size);
+}
+DeviceInformation SimEnv::getDeviceInfo()
+{
+   DeviceInformation d;
+   d.devices.resize(deviceCount());
+   for (int i = 0; i < deviceCount(); i++) {
+      d.devices[i].id = i;
+      d.devices[i].name = raidCtl->name(i);
+      d.devices[i].fd = -1;
+   }
+   return d;
+}
+SimEnv::SmartLog SimEnv::smartLog(int device)
+{
+   return devices.at(device)->smartLog();
+}
+// -------------------------------------------------------------------------------------
+// Channel
+// -------------------------------------------------------------------------------------
+SimChannel::SimChannel(RaidController<int>& raidCtl, std::vector<std::unique_ptr<SimDevice>>& devices, IoOptions ioOptions)
+   : raidCtl(raidCtl), devices(devices), ioOptions(ioOptions)
+{
+   request_stack.reserve(ioOptions.iodepth);
+}
+void SimChannel::_push(RaidRequest<SimIoRequest>* req)
+{
+   request_stack.push_back(req);
+}
+int SimChannel::_submit()
+{
+   const int cnt = request_stack.size();
+   for (auto req : request_stack) {
+      const u64 latency = devices.at(req->base.device)->io(req->base.type, req->base.buffer(), req->base.offset, req->base.len, req->base.hint);
+      req->impl.completion = hostNanos() + latency;
+      latencySum += latency;
+      inflight.push({req->impl.completion, req});
+   }
+   submitted += cnt;
+   request_stack.clear();
+   return cnt;
+}
+int SimChannel::_poll(int min)
+{
+   int done = 0;
+   do {
+      const u64 now = hostNanos();
+      while (!inflight.empty() && inflight.top().first <= now) {
+         auto req = inflight.top().second;
+         inflight.pop();
+         req->base.innerCallback.callback(&req->base);
+         done++;
+      }
+   } while (done < min && !inflight.empty());
+   return done;
+}
+void SimChannel::_printSpecializedCounters(std::ostream& ss)
+{
+   ss << "sim: submitted: " << submitted << " avg latency: " << (submitted > 0 ? latencySum / submitted / 1000.0 : 0) << "us";
+}
+void SimChannel::pushBlocking(IoRequestType type, char* data, s64 addr, u64 len, [[maybe_unused]] bool write_back)
+{
+   int* device;
+   u64 raidedOffset;
+   raidCtl.calc(addr, len, device, raidedOffset);
+   devices.at(*device)->io(type, data, raidedOffset, len, -1);
+}
+// -------------------------------------------------------------------------------------
+}  // namespace mean
+// -------------------------------------------------------------------------------------
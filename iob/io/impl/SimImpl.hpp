@@ -0,0 +1,88 @@
+#pragma once
+// -------------------------------------------------------------------------------------
+#include "../IoAbstraction.hpp"
+#include "../Raid.hpp"
+#include "../RequestStack.hpp"
+#include "../BufferPool.hpp"
+// -------------------------------------------------------------------------------------
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+// -------------------------------------------------------------------------------------
+namespace mean
+{
+// -------------------------------------------------------------------------------------
+// IOENGINE=sim: every device of FILENAME ("sim0;sim1" for RAID0) is the simulator's SSD
+// model with a GC policy and its timing model, no NVMe device needed. A request is
+// executed on the model when it is submitted and completes once the simulated latency
+// has passed on the host clock. Page contents are kept in memory (SIM_DATA=0: not kept,
+// reads return zeros, use INIT=disable).
+// -------------------------------------------------------------------------------------
+class SimDevice;
+class SimChannel;
+class SimEnv
+{
+   std::unique_ptr<RaidController<int>> raidCtl;
+   std::vector<std::unique_ptr<SimDevice>> devices;
+   IoOptions ioOptions;
+   static SimEnv* _active;
+  public:
+   std::unordered_map<int, std::unique_ptr<SimChannel>> channels;
+   // -------------------------------------------------------------------------------------
+   SimEnv();
+   ~SimEnv();
+   void init(IoOptions options);
+   int deviceCount();
+   int channelCount();
+   u64 storageSize();
+   SimChannel& getIoChannel(int channel);
+   // -------------------------------------------------------------------------------------
+   void* allocIoMemory(size_t size, size_t align);
+   void freeIoMemory(void* ptr, size_t size = 0);
+   void* allocPoolMemory(u64& size, int numaNode);
+   void freePoolMemory(void* ptr, u64 size);
+   DeviceInformation getDeviceInfo();
+   // -------------------------------------------------------------------------------------
+   // the emulated devices' counterpart of the OCP SMART log, for NvmeLog
+   struct SmartLog {
+      u64 physicalBytesWritten = 0;
+      u64 physicalBytesRead = 0;
+      u64 maxEraseCount = 0;
+      u64 minEraseCount = 0;
+      u8 percentFreeBlocks = 0;
+   };
+   static SimEnv* active() { return _active; }
+   SmartLog smartLog(int device);
+};
+// -------------------------------------------------------------------------------------
+struct SimIoRequest {
+   u64 completion = 0; // ns, host clock
+};
+class SimChannel
+{
+   RaidController<int>& raidCtl;
+   std::vector<std::unique_ptr<SimDevice>>& devices;
+   IoOptions ioOptions;
+   std::vector<RaidRequest<SimIoRequest>*> request_stack;
+   using InFlight = std::pair<u64, RaidRequest<SimIoRequest>*>;
+   std::priority_queue<InFlight, std::vector<InFlight>, std::greater<InFlight>> inflight;
+   u64 submitted = 0;
+   u64 latencySum = 0;
+  public:
+   SimChannel(RaidController<int>& raidCtl, std::vector<std::unique_ptr<SimDevice>>& devices, IoOptions ioOptions);
+   // -------------------------------------------------------------------------------------
+   void _push(RaidRequest<SimIoRequest>* req);
+   int _submit();
+   int _poll(int min = 0);
+   void _printSpecializedCounters(std::ostream& ss);
+   int registerBuffers(std::vector<std::pair<void*, uint64_t>>&) { return 0; }
+   void pushBlocking(IoRequestType type, char* data, s64 addr, u64 len, bool write_back);
+};
+// -------------------------------------------------------------------------------------
+}  // namespace mean
+// -------------------------------------------------------------------------------------
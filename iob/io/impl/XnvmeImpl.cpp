@@ -34,7 +34,7 @@ XnvmeEnv::~XnvmeEnv()
 void XnvmeEnv::init(IoOptions options)
 {
    this->ioOptions = options;
-   raidCtl = std::make_unique<RaidController<XnvmeDevQueues>>(ioOptions.path);
+   raidCtl = std::make_unique<RaidController<XnvmeDevQueues>>(ioOptions.path, ioOptions.raid, ioOptions.stripe_size);
    raidCtl->forEach([this](std::string& dev, XnvmeDevQueues& fd) {
       xnvme_opts ops = xnvme_opts_default();
       std::string e = ioOptions.engine;
@@ -192,9 +192,8 @@ void XnvmeChannel::submission(SubmissionFun subFun, RaidRequest<XnvmeRequest>* r
       cbReq->base.innerCallback.callback(&cbReq->base);
       xnvme_queue_put_cmd_ctx(ctx->async.queue, ctx);
    };
-   XnvmeDevQueues* device;
-   u64 raidedOffset;
-   raidCtl.calc(req->base.addr, req->base.len, device, raidedOffset);
+   XnvmeDevQueues* device = raidCtl.devicePtr(req->base.device);
+   u64 raidedOffset = req->base.offset;
    int err = -1;
    struct xnvme_cmd_ctx *ctx = xnvme_queue_get_cmd_ctx(device->queues[queue]);
    ensure(ctx);
@@ -16,13 +16,13 @@
 #include <iomanip>
 #include <mutex>
 
-static void initializeSSDIfNecessary(mean::FileState& fileState, long maxPage, long bufSize, std::string init, int iodepth) {
+static void initializeSSDIfNecessary(mean::FileState& fileState, long maxPage, long bufSize, std::string init, int iodepth, long stripeSize) {
    using namespace mean;
    // check if necessary
    IoChannel& ioChannel = IoInterface::instance().getIoChannel(0);
 
-   int initBufSize = 512*1024; // FIXME: this might not work with SPDK on some SSDs, check for max transfer size and use that.
-   char* buf = (char*)IoInterface::instance().allocIoMemoryChecked(initBufSize + 512, 512);
+   int initBufSize = std::min(512l*1024, stripeSize); // FIXME: this might not work with SPDK on some SSDs, check for max transfer size and use that.
+   char* buf = (char*)IoInterface::bufferPool(0).alloc(initBufSize + 512, 512);
    memset(buf, 0, initBufSize);
 
    long iniOps = maxPage*bufSize / initBufSize +1; // +1 because you need to round up 
@@ -86,7 +86,7 @@ static void initializeSSDIfNecessary(mean::FileState& fileState, long maxPage, l
       fileState.checkBuffer(buf, maxPage*bufSize, bufSize);
       // check all 
    }
-   IoInterface::instance().freeIoMemory(buf);
+   IoInterface::bufferPool(0).release(buf);
 }
 
 class RequestGeneratorThread : public mean::ThreadBase {
@@ -96,7 +96,6 @@ public:
    RequestGeneratorThread(mean::JobOptions jobOptions, int thr, atomic<long>& time, iob::PatternGen& patternGen, mean::FileState& fileState)
       : ThreadBase("gent", thr), 
       gen(std::to_string(thr), jobOptions, mean::IoInterface::instance().getIoChannel(thr), thr, time, patternGen, fileState) {
-         //setCpuAffinityBeforeStart(thr);
    }
    int process() override {
       gen.runIo();
@@ -129,6 +128,27 @@ int main(int , char** ) {
    ioOptions.channelCount = threads;
    ioOptions.ioUringPollMode = getEnv("IOUPOLL", 0); // keep default off, as queues must be set in kernel parameters
    ioOptions.ioUringNVMePassthrough = getEnv("IOUPT", 0);
+   ioOptions.placement = IoOptions::placementFromString(getEnv("PLACEMENT", "none")); // write hints as NVMe streams or FDP placement ids (needs IOUPT)
+   ioOptions.placement_ids = getEnv("PLACEMENT_IDS", 8);
+   ioOptions.ioUringFixedBuffers = getEnv("IOUFIXED", 0); // register the buffer pools as io_uring fixed buffers
+   ioOptions.ioUringShareWq = getEnv("IOUSQPOLL", 0); // number of SQPOLL threads, shared round robin by the rings
+   ioOptions.hugepage_size = getBytesFromString(getEnv("HUGEPAGES", "2M")); // 2M, 1G or 0 for transparent hugepages
+   ioOptions.numa_node = getEnv("NUMA_NODE", -1);
+   ioOptions.raid = IoOptions::raidLevelFromString(getEnv("RAID", "0")); // FILENAME="dev1;dev2;..." for multiple devices
+   ioOptions.stripe_size = getBytesFromString(getEnv("STRIPE_SIZE", "1M"));
+   ioOptions.check();
+   // CPUS=auto: cpus of the devices' numa nodes, CPUS=0-7,16: explicit list, empty: no pinning
+   std::vector<std::string> devices;
+   {
+      std::stringstream ss(filename);
+      std::string dev;
+      while (std::getline(ss, dev, ';')) { devices.push_back(dev); }
+   }
+   const std::string cpuSpec = getEnv("CPUS", "");
+   auto placement = topology::CpuPlacement::plan(cpuSpec, devices, threads, ioOptions.ioUringShareWq);
+   ioOptions.channel_cpus = placement.workers;
+   ioOptions.sq_thread_cpus = placement.sqPoll;
+   if ((u64)bufSize > ioOptions.stripe_size) { throw std::logic_error("BS must not be larger than STRIPE_SIZE"); }
 
    // filesize
    IoInterface::initInstance(ioOptions);
@@ -174,9 +194,15 @@ int main(int , char** ) {
    std::cout << "INIT: " << init << std::endl;
    std::cout << "IO_DEPTH: " << ioOptions.iodepth << std::endl;
    std::cout << "IOENGING: " << ioEngine << std::endl;
+   std::cout << "RAID: " << getEnv("RAID", "0") << " STRIPE_SIZE: " << ioOptions.stripe_size << std::endl;
+   std::cout << "CPUS: " << cpuSpec << " workers:";
+   for (int c: placement.workers) { std::cout << " " << c; }
+   std::cout << " sqpoll:";
+   for (int c: placement.sqPoll) { std::cout << " " << c; }
+   std::cout << " stats: " << placement.stats << std::endl;
 
    mean::FileState fileState{(maxPage+1)*bufSize, crc, deepCheck, randomData};
-   initializeSSDIfNecessary(fileState, maxPage, bufSize, init, ioOptions.iodepth);
+   initializeSSDIfNecessary(fileState, maxPage, bufSize, init, ioOptions.iodepth, ioOptions.stripe_size);
 
    if (ioSize == 0) {
       return 0;
@@ -197,7 +223,33 @@ int main(int , char** ) {
 
    auto pgOptions = iob::PatternGen::loadOptionsFromEnv(jobOptions.filesize / jobOptions.bs, jobOptions.bs);
   // iob::PatternGen::printPatternHistorgram(pgOptions);
-   iob::PatternGen patternGen(pgOptions);
+   // PARTITION=shared (default): all threads draw from one PatternGen. slice / interleave: every
+   // thread has its own PatternGen over 1/THREADS of the blocks, no shared state between threads
+   const std::string partition = getEnv("PARTITION", "shared");
+   const bool zns = iob::PatternGen::stringToPattern(pgOptions.patternString) == iob::PatternGen::Pattern::ZNS;
+   std::vector<std::unique_ptr<iob::PatternGen>> threadPatternGens;
+   if (partition == "shared") {
+      threadPatternGens.push_back(std::make_unique<iob::PatternGen>(pgOptions));
+   } else if (partition == "slice" || partition == "interleave") {
+      jobOptions.partition = partition == "slice" ? JobOptions::Partition::Slice : JobOptions::Partition::Interleave;
+      // a zone reset discards a contiguous zone, interleaved threads do not own one
+      if (zns && jobOptions.partition == JobOptions::Partition::Interleave) {
+         throw std::logic_error("PATTERN=zns needs PARTITION=shared or slice");
+      }
+      auto threadOptions = pgOptions;
+      threadOptions.logicalPages = pgOptions.logicalPages / threads;
+      if (zns) {
+         // slices start at a zone boundary
+         threadOptions.logicalPages -= threadOptions.logicalPages % pgOptions.znsPagesPerZone;
+      }
+      threadOptions.totalWrites = pgOptions.totalWrites / threads;
+      for (int thr = 0; thr < threads; thr++) {
+         threadPatternGens.push_back(std::make_unique<iob::PatternGen>(threadOptions));
+      }
+   } else {
+      throw std::logic_error("PARTITION must be shared, slice or interleave");
+   }
+   auto patternGenOf = [&](int thr) -> iob::PatternGen& { return *threadPatternGens.at(jobOptions.partition == JobOptions::Partition::Shared ? 0 : thr); };
 
    jobOptions.disableChecks = init == "disable";
    jobOptions.filename = filename;
@@ -211,12 +263,18 @@ int main(int , char** ) {
    jobOptions.totalRate = getEnv("RATE", 0);
    jobOptions.rateLimit = jobOptions.totalRate / threads;
    jobOptions.exponentialRate = getEnv("EXPRATE", true);
+   jobOptions.openLoop = getEnv("OPENLOOP", 0); // latency from the intended start of each arrival
+   jobOptions.maxBacklog = getEnv("OPENLOOP_MAX_BACKLOG", 1 << 20);
+   if (jobOptions.openLoop && jobOptions.totalRate <= 0) { throw std::logic_error("OPENLOOP needs RATE"); }
+   // streaming binary trace of completed I/Os, convert with iotrace/iotrace
+   jobOptions.enableIoTracing = getEnv("IOTRACE", 0);
+   if (jobOptions.enableIoTracing) {
+      IoTraceWriter::startGlobal("iob-trace-"+prefix+".bin", threads, getEnv("IOTRACE_RING", 1 << 20), getEnv("IOTRACE_SAMPLE", 1.0));
+   }
 
    jobOptions.logHash = getTimeStampStr();
    std::ofstream dump;
    dump.open("iob-dump-"+prefix+".csv", std::ios_base::app);
-   IoTrace::IoStat::dumpIoStatHeader(dump, "iodepth, bs, io_alignment,");
-   dump << std::endl;
 
    std::cout << jobOptions.print();
 
@@ -238,24 +296,32 @@ int main(int , char** ) {
       propOptions.rateLimit = 10000;
       propOptions.exponentialRate = 0;
       propOptions.writePercent = 0.5;
-      threadVec.emplace_back(std::move(std::make_unique<RequestGeneratorThread>(propOptions, 0, time, patternGen, fileState)));
+      threadVec.emplace_back(std::move(std::make_unique<RequestGeneratorThread>(propOptions, 0, time, patternGenOf(0), fileState)));
       for (int thr = 1; thr < threads; thr++) {
          jobOptions.name = "gen " + std::to_string(thr);
          jobOptions.rateLimit = (jobOptions.totalRate - ((double)propOptions.rateLimit*propOptions.writePercent)) / (threads-1);
-         threadVec.emplace_back(std::move(std::make_unique<RequestGeneratorThread>(jobOptions, thr, time, patternGen, fileState)));
+         threadVec.emplace_back(std::move(std::make_unique<RequestGeneratorThread>(jobOptions, thr, time, patternGenOf(thr), fileState)));
       }
    } else {
       for (int thr = 0; thr < threads; thr++) {
          jobOptions.name = "gen " + std::to_string(thr);
          jobOptions.rateLimit = jobOptions.totalRate / threads;
-         threadVec.emplace_back(std::move(std::make_unique<RequestGeneratorThread>(jobOptions, thr, time, patternGen, fileState)));
+         threadVec.emplace_back(std::move(std::make_unique<RequestGeneratorThread>(jobOptions, thr, time, patternGenOf(thr), fileState)));
       }
    }
    std::cout << "run" << endl;
    std::this_thread::sleep_for(std::chrono::milliseconds(1));
    for (auto& t: threadVec) {
+      t->setCpuAffinityBeforeStart(placement.workers.at(t->id()));
       t->start();
    }
+   if (placement.stats >= 0) {
+      // the main thread collects the stats
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(placement.stats, &cpuset);
+      posix_check(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0, "stats thread affinity could not be set");
+   }
 
    long maxRead = 0;
    //if (runtimeLimit > 0) {
@@ -325,7 +391,7 @@ int main(int , char** ) {
       ss << "," << jobOptions.logHash;
       ss << "," << time;
       ss << "," << (now - start);
-      ss << "," << filename << "," << filesize/GIBI << "," << fill << "," << jobOptions.filesize*1.0/GIBI << "," << patternGen.options.patternString << ",\"" << patternGen.patternDetails() << "\"";
+      ss << "," << filename << "," << filesize/GIBI << "," << fill << "," << jobOptions.filesize*1.0/GIBI << "," << patternGenOf(0).options.patternString << ",\"" << patternGenOf(0).patternDetails() << "\"";
       ss << "," << jobOptions.totalRate; 
       ss << "," << jobOptions.exponentialRate; 
       ss << "," << jobOptions.writePercent; 
@@ -370,10 +436,12 @@ int main(int , char** ) {
              "echo -n \""+smartLine+",ocp,\"                                 >> iob-smart-"+prefix+".csv" +
              " ; sudo nvme ocp smart-add-log "+filename+" --output-format=json  2> /dev/null | tr -d '\\n'      >> iob-smart-"+prefix+".csv" +
              " ; echo ""                                                                          >> iob-smart-"+prefix+".csv";
-      int sys = system(sysSmart.c_str());
-      assert(sys == 0);
-      sys = system(sysOCP.c_str());
-      assert(sys == 0);
+      if (ioEngine != "sim") { // no nvme-cli for emulated devices
+         int sys = system(sysSmart.c_str());
+         assert(sys == 0);
+         sys = system(sysOCP.c_str());
+         assert(sys == 0);
+      }
       //cout << sys << endl;
 
       now = getSeconds();
@@ -409,6 +477,7 @@ int main(int , char** ) {
    for (auto& t: threadVec) {
       t->join();
    }
+   IoTraceWriter::stopGlobal();
    std::ofstream patDump;
    patDump.open("iob-patdump-"+prefix+".csv", std::ios_base::app);
    RequestGenerator::dumpPatternAccessHeader(patDump, "");
@@ -438,7 +507,6 @@ int main(int , char** ) {
       w99p9 += t->gen.stats.writeHist.getPercentile(99.9);
       rTotalTime += t->gen.stats.readTotalTime;
       wTotalTime += t->gen.stats.writeTotalTime;
-      t->gen.ioTrace.dumpIoTrace(dump, std::to_string(jobOptions.iodepth) + "," + std::to_string(jobOptions.bs) + "," + std::to_string(jobOptions.io_alignment) + ",");
       t->gen.aggregatePatternAccess(accessHist);
       cout << endl;
       t->gen.samplePatternAccess(sampleLocs, accesses);
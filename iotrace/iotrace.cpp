@@ -0,0 +1,77 @@
+// Converts the binary trace of iob (IOTRACE=1 -> iob-trace-<prefix>.bin)
+//  FORMAT=csv:     one csv line per I/O, times in ns since trace start
+//  FORMAT=columns: one raw little-endian file per column (<OUT>.<column>.bin),
+//                  u64 for times and addr, u32 for len/reqId, u16 threadId, u8 type
+#include "../shared/Env.hpp"
+#include "io/IoTrace.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace mean;
+
+int main() {
+   const std::string in = getEnvRequired("IN");
+   const std::string format = getEnv("FORMAT", "csv");
+   const std::string out = getEnv("OUT", in.substr(0, in.rfind('.')));
+
+   std::ifstream trace(in, std::ios::binary);
+   if (!trace.good()) {
+      std::cerr << "could not open " << in << std::endl;
+      return 1;
+   }
+   IoTraceFileHeader header;
+   trace.read((char*)&header, sizeof(header));
+   if (!trace || std::memcmp(header.magic, IoTraceFileHeader::MAGIC, sizeof(header.magic)) != 0) {
+      std::cerr << in << " is not an iob trace" << std::endl;
+      return 1;
+   }
+   if (header.version != IoTraceFileHeader::VERSION || header.recordSize != sizeof(IoTraceRecord)) {
+      std::cerr << "unsupported trace version " << header.version << " record size " << header.recordSize << std::endl;
+      return 1;
+   }
+   auto ns = [&](u64 tsc) -> long { return ((double)tsc - (double)header.baseTsc) / header.tscPerNs; };
+
+   std::ofstream csv;
+   std::map<std::string, std::ofstream> columns;
+   if (format == "csv") {
+      csv.open(out + ".csv");
+      csv << "threadid,reqId,type,begin,submit,end,addr,len" << std::endl;
+   } else if (format == "columns") {
+      for (auto c: {"threadid", "reqId", "type", "begin", "submit", "end", "addr", "len"}) {
+         columns[c].open(out + "." + c + ".bin", std::ios::binary);
+      }
+   } else {
+      std::cerr << "FORMAT must be csv or columns" << std::endl;
+      return 1;
+   }
+   auto put = [&](const char* col, auto v) { columns[col].write((const char*)&v, sizeof(v)); };
+
+   std::vector<IoTraceRecord> chunk(1 << 16);
+   u64 records = 0;
+   while (trace) {
+      trace.read((char*)chunk.data(), chunk.size() * sizeof(IoTraceRecord));
+      const u64 n = trace.gcount() / sizeof(IoTraceRecord);
+      for (u64 i = 0; i < n; i++) {
+         auto& r = chunk[i];
+         if (format == "csv") {
+            csv << r.threadId << "," << r.reqId << "," << (int)r.type << "," << ns(r.begin) << "," << ns(r.submit) << "," << ns(r.end) << "," << r.addr << "," << r.len << "\n";
+         } else {
+            put("threadid", r.threadId);
+            put("reqId", r.reqId);
+            put("type", r.type);
+            put("begin", (long)ns(r.begin));
+            put("submit", (long)ns(r.submit));
+            put("end", (long)ns(r.end));
+            put("addr", r.addr);
+            put("len", r.len);
+         }
+      }
+      records += n;
+   }
+   std::cout << records << " records (1 in " << header.sampleEvery << " I/Os sampled) -> " << out << (format == "csv" ? ".csv" : ".<column>.bin") << std::endl;
+   return 0;
+}
@@ -0,0 +1,25 @@
+#!/bin/bash
+# Thread scaling of the pattern generation: shared PatternGen vs. one per thread.
+# Defaults to the emulated device without latency, so the IOPS are the host-side limit.
+#   ./benchpartition.sh [FILENAME] [PREFIX] [IOENGINE]
+set -x
+
+export FILENAME=${1:-sim0}
+export PREFIX=${2:-partition}
+export IOENGINE=${3:-sim}
+export SIM_TIMING=0
+export SIM_DATA=0
+export SIM_CAPACITY=${SIM_CAPACITY:-64G}
+
+cmake -DCMAKE_BUILD_TYPE=Release ..
+make -j iob
+
+for PATTERN in uniform sequential zipf zns-noshuffle ; do
+for PARTITION in shared slice interleave ; do
+# zone resets need a contiguous zone per thread
+[[ $PATTERN == zns* && $PARTITION == interleave ]] && continue
+for THR in 1 2 4 8 16 32 ; do
+	sudo -E FILENAME=$FILENAME INIT=disable RUNTIME=30 IO_DEPTH=128 BS=4K THREADS=$THR PATTERN=$PATTERN ZIPF=1.0 ZNS_ZONE_SIZE=1G PARTITION=$PARTITION RW=1 iob/iob >> iob-output-$PREFIX.csv
+done
+done
+done
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Keyed bijection on [0, n): a balanced Feistel network on the smallest even number of
+// bits covering n, values outside [0, n) are mapped again (cycle walking). The Feistel
+// domain is less than 4n, so a lookup takes fewer than 4 network evaluations on average.
+// Replaces a materialized shuffled vector: no memory, no setup, no cache misses.
+class FeistelPermutation {
+    static constexpr int rounds = 4;
+    uint64_t n;
+    int halfBits;
+    uint64_t halfMask;
+    std::array<uint64_t, rounds> keys;
+
+    static uint64_t mix(uint64_t x) {
+        // splitmix64 finalizer
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    uint64_t encrypt(uint64_t x) const {
+        uint64_t left = x >> halfBits;
+        uint64_t right = x & halfMask;
+        for (int r = 0; r < rounds; r++) {
+            uint64_t next = left ^ (mix(right ^ keys[r]) & halfMask);
+            left = right;
+            right = next;
+        }
+        return (left << halfBits) | right;
+    }
+
+public:
+    FeistelPermutation(uint64_t n, uint64_t seed) : n(n) {
+        if (n == 0) {
+            throw std::invalid_argument("FeistelPermutation: empty domain");
+        }
+        int bits = 2;
+        while (bits < 64 && (1ULL << bits) < n) {
+            bits += 2;
+        }
+        halfBits = bits / 2;
+        halfMask = (1ULL << halfBits) - 1;
+        for (int r = 0; r < rounds; r++) {
+            keys[r] = mix(seed + 0x9e3779b97f4a7c15ULL * (r + 1));
+        }
+    }
+
+    uint64_t operator()(uint64_t x) const {
+        do {
+            x = encrypt(x);
+        } while (x >= n);
+        return x;
+    }
+
+    uint64_t size() const { return n; }
+
+    // maps every value once, n bits of memory; throws if two values collide
+    void verify() const {
+        std::vector<bool> seen(n, false);
+        for (uint64_t x = 0; x < n; x++) {
+            uint64_t y = (*this)(x);
+            if (y >= n || seen[y]) {
+                throw std::logic_error("FeistelPermutation is not a permutation of " + std::to_string(n) + " at " + std::to_string(x));
+            }
+            seen[y] = true;
+        }
+    }
+};
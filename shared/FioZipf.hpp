@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// fio's zipf and pareto generators (lib/zipf.c, lib/rand.c), the ones behind
+// random_distribution=zipf:<theta> / pareto:<h> and t/genzipf. Same seed, same sequence
+// as fio: taus88 as the source, values hashed over the range and rotated by a random
+// offset. next() returns a value in [0, n).
+class FioZipf {
+public:
+    enum class Distribution { Zipf, Pareto };
+
+private:
+    // taus88, fio's 32 bit generator
+    struct Taus88 {
+        uint32_t s1 = 0, s2 = 0, s3 = 0;
+
+        static uint32_t seedAtLeast(uint32_t x, uint32_t m) { return x < m ? x + m : x; }
+
+        void init(uint32_t seed) {
+            // fio's LCG start value reads (2^31) + (2^17) + (2^7), which is 53 in C
+            s1 = seedAtLeast(53u * 69069u ^ seed, 1);
+            s2 = seedAtLeast(s1 * 69069u ^ seed, 7);
+            s3 = seedAtLeast(s2 * 69069u ^ seed, 15);
+            for (int crank = 0; crank < 6; crank++) {
+                next();
+            }
+        }
+
+        uint32_t next() {
+            s1 = ((s1 & 4294967294u) << 12) ^ (((s1 << 13) ^ s1) >> 19);
+            s2 = ((s2 & 4294967288u) << 4) ^ (((s2 << 2) ^ s2) >> 25);
+            s3 = ((s3 & 4294967280u) << 17) ^ (((s3 << 3) ^ s3) >> 11);
+            return s1 ^ s2 ^ s3;
+        }
+    };
+
+    static constexpr uint64_t maxZetaTerms = 10000000; // ZIPF_MAX_GEN
+    static constexpr double randMax = 4294967295.0;     // FRAND32_MAX
+
+    static uint64_t hash(uint64_t val) { return val * 0x61C8864680B583EBULL; }
+
+    const Distribution dist;
+    const uint64_t n;
+    Taus88 rand;
+    uint64_t randOff = 0;
+    bool disableHash = false;
+    // zipf
+    double theta = 0;
+    double zeta2 = 0;
+    double zetan = 0;
+    double alpha = 0;
+    double eta = 0;
+    // pareto
+    double paretoPow = 0;
+
+public:
+    // param: theta for zipf, h in (0, 1) for pareto. center in [0, 1) fixes the offset
+    // the hot values are rotated to, -1 picks it at random like fio does
+    FioZipf(Distribution dist, uint64_t n, double param, uint32_t seed, double center = -1)
+        : dist(dist), n(n) {
+        if (n == 0) {
+            throw std::invalid_argument("FioZipf: empty range");
+        }
+        rand.init(seed);
+        randOff = rand.next();
+        if (center != -1) {
+            randOff = n * center;
+        }
+        if (dist == Distribution::Zipf) {
+            if (param == 1.0) {
+                throw std::invalid_argument("FioZipf: zipf theta must not be 1.0");
+            }
+            theta = param;
+            zeta2 = std::pow(1.0, theta) + std::pow(0.5, theta);
+            const uint64_t terms = std::min(n, maxZetaTerms);
+            for (uint64_t i = 0; i < terms; i++) {
+                zetan += std::pow(1.0 / (double)(i + 1), theta);
+            }
+            // loop invariant parts of zipf_next
+            alpha = 1.0 / (1.0 - theta);
+            eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+        } else {
+            if (param <= 0.0 || param >= 1.0) {
+                throw std::invalid_argument("FioZipf: pareto h must be in (0, 1)");
+            }
+            paretoPow = std::log(param) / std::log(1.0 - param);
+        }
+    }
+
+    // without the hash, the hottest values are neighbours starting at the offset
+    void setDisableHash(bool disable) { disableHash = disable; }
+
+    uint64_t next() {
+        const double randUni = (double)rand.next() / randMax;
+        uint64_t val;
+        if (dist == Distribution::Zipf) {
+            const double randZ = randUni * zetan;
+            if (randZ < 1.0) {
+                val = 0;
+            } else if (randZ < 1.0 + std::pow(0.5, theta)) {
+                val = 1;
+            } else {
+                val = (uint64_t)(n * std::pow(eta * randUni - eta + 1.0, alpha));
+            }
+        } else {
+            val = (uint64_t)((n - 1) * std::pow(randUni, paretoPow));
+        }
+        if (!disableHash) {
+            val = hash(val);
+        }
+        return (val + randOff) % n;
+    }
+
+    void next(std::vector<uint64_t>& out, size_t count) {
+        out.resize(count);
+        for (auto& v : out) {
+            v = next();
+        }
+    }
+};
@@ -63,7 +63,7 @@ public:
 		long sum = std::accumulate(histData.begin(), histData.end(), 0, std::plus<int>());
 		long sumUntilPercentile = 0;
 		const long percentile = sum * (iThPercentile / 100.0);
-		valueType i = 0;
+		size_t i = 0;
 		for (; sumUntilPercentile < percentile && i < histData.size(); i++) {
 			sumUntilPercentile += histData[i];
 		}
@@ -3,7 +3,9 @@
 #include "Exceptions.hpp"
 #include "Env.hpp"
 #include "../traces/src/ParseTraces.hpp"
-#include "RejectionInversionZipf.hpp"
+#include "ZipfSampler.hpp"
+#include "FeistelPermutation.hpp"
+#include "FioZipf.hpp"
 
 #include <algorithm>
 #include <atomic>
@@ -12,6 +14,7 @@
 #include <csignal>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
@@ -20,7 +23,9 @@
 #include <memory>
 #include <mutex>
 #include <numeric>
+#include <optional>
 #include <random>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -50,6 +55,9 @@ public:
         SeqZones,
         LSM,
         LSMNoWA,
+        LSMLeveled,
+        Schedule,
+        Tenants,
         Undefined
     };
 
@@ -68,6 +76,35 @@ public:
 
         uint64_t znsActiveZones = 4;
         uint64_t znsPagesPerZone = 0;
+
+        string scheduleString;
+
+        // vector: shuffled page vector (8 bytes per page), feistel: FeistelPermutation
+        string shuffleMode = "vector";
+
+        // fiozipf / fiopareto: seed of fio's generator, same seed same sequence
+        uint32_t fioSeed = 1;
+
+        // dboutofplace: share of the pages the database occupies, dirty page buffer (share
+        // of the database), B-tree fanout, zipf skew of the leaf updates (0: uniform),
+        // log segment size in pages (0: 16 MiB) and the free segments that trigger cleaning
+        double dbFill = 0.8;
+        double dbBuffer = 0.05;
+        uint64_t dbFanout = 256;
+        double dbSkew = 0.0;
+        uint64_t dbSegmentPages = 0;
+        uint64_t dbCleanFree = 2;
+
+        // lsmleveled: unique data as share of the pages, memtable and SST size in pages
+        // (0: 64 MiB), L1 target size in pages (0: 256 MiB), size ratio between levels, L0
+        // files that trigger a compaction, levels including L0 (0: as many as the data needs)
+        double lsmFill = 0.3;
+        uint64_t lsmMemtablePages = 0;
+        uint64_t lsmSstPages = 0;
+        uint64_t lsmL1Pages = 0;
+        double lsmRatio = 10;
+        uint64_t lsmL0Trigger = 4;
+        uint64_t lsmLevels = 0;
     };
 
     Options options;
@@ -76,6 +113,7 @@ public:
 
     // Shuffle
     std::vector<uint64_t> updatePattern;
+    std::optional<FeistelPermutation> permutation;
 
     // Sequential
     std::atomic<uint64_t> seq{0};
@@ -109,8 +147,14 @@ public:
         }
     };
 
-    // Zipf for page selection
-    RejectionInversionZipfSampler zipfSampler;
+    // Zipf for page selection, only sized for the zipf pattern
+    ZipfSampler zipfSampler;
+
+    // fio zipf / pareto, drawn in batches of chunkSize
+    std::unique_ptr<FioZipf> fioGen;
+    std::vector<uint64_t> fioBatch;
+    size_t fioBatchPos = 0;
+    std::mutex fioMutex;
 
     // Traces
     std::vector<uint64_t> inputTraces;
@@ -143,7 +187,7 @@ public:
     bool activeSlotDistInit = false;
 
     // Zipf sampler for zone selection (cannot be assigned; keep via ptr)
-    std::unique_ptr<RejectionInversionZipfSampler> zipfZoneSampler;
+    std::unique_ptr<ZipfSampler> zipfZoneSampler;
 
     // Cached active slot count
     uint64_t activeCount = 0;
@@ -192,11 +236,88 @@ std::atomic<uint64_t> lsmRegion0Writes{0}; // cumulative writes to region0
 std::atomic<uint64_t> lsmR1Pos{0};
 std::atomic<uint64_t> lsmR1Remaining{0};
 
+    // ---------------- Schedule state ----------------
+    // phases run one after another and repeat, all generators are built up front
+    struct Phase {
+        uint64_t writes = 0;
+        double drift = 0.0; // pages the hot set moves per write
+        std::string spec;
+        std::unique_ptr<PatternGen> gen;
+    };
+    std::vector<Phase> phases;
+    uint64_t scheduleLength = 0;
+    std::atomic<uint64_t> scheduleWrites{0};
+
+    // queued host I/O of the DB/LSM patterns, handed out one write at a time
+    struct PendingOp {
+        uint64_t page = 0;
+        uint64_t count = 0; // trim of count pages, 0 for a write
+        uint8_t hint = 0;
+    };
+
+    // ---------------- DBOutOfPlace state ----------------
+    // B-tree pages [0, dbPages): leaves first, then each inner level
+    static constexpr uint32_t dbNone = UINT32_MAX;
+    uint64_t dbPages = 0;
+    std::vector<uint64_t> dbLevelStart; // first page of each level, leaves at 0
+    std::vector<uint32_t> dbLoc;        // page -> LBA
+    std::vector<uint32_t> dbOwner;      // LBA -> page
+    std::unique_ptr<ZipfSampler> dbLeafSampler;
+    // dirty pages in the buffer pool, evicted by CLOCK
+    std::vector<uint32_t> dbFrame;      // page -> frame
+    std::vector<uint32_t> dbFramePage;
+    std::vector<uint8_t> dbFrameRef;
+    uint64_t dbFrameCapacity = 0;
+    uint64_t dbClockHand = 0;
+    // log segments: one open for evictions, one for relocations by the cleaner
+    uint64_t dbSegments = 0;
+    std::vector<uint64_t> dbSegmentValid;
+    std::vector<uint64_t> dbFreeSegments;
+    std::vector<uint8_t> dbSegmentFree;
+    enum DbStream { DbUser = 0, DbClean = 1 };
+    uint64_t dbOpenSegment[2] = {0, 0};
+    uint64_t dbOpenPos[2] = {0, 0};
+    std::vector<PendingOp> dbPending;
+    size_t dbPendingPos = 0;
+    std::mutex dbMutex;
+    std::bernoulli_distribution dbSplit;
+    std::uniform_int_distribution<uint64_t> dbLeafDist;
+    std::atomic<uint64_t> dbEvictionWrites{0};
+    std::atomic<uint64_t> dbCleanWrites{0};
+
+    // ---------------- LSMLeveled state ----------------
+    // a file covers the key range [lo, hi) of the normalized key space, one key per page;
+    // its pages are allocated in slots of the smaller of memtable and SST size
+    struct LsmFile {
+        double lo = 0.0;
+        double hi = 1.0;
+        uint64_t pages = 0;
+        std::vector<uint64_t> slots;
+    };
+    std::vector<std::vector<LsmFile>> lsmLevelFiles; // L0 by age, the others by key
+    std::vector<uint64_t> lsmLevelPages;
+    std::vector<uint64_t> lsmLevelTarget;
+    std::vector<double> lsmCursor;                    // round-robin compaction key per level
+    uint64_t lsmKeys = 0;
+    uint64_t lsmSlotPages = 0;
+    std::set<uint64_t> lsmFreeSlots;
+    LsmFile lsmWal;
+    std::vector<PendingOp> lsmPending;
+    size_t lsmPendingPos = 0;
+    std::mutex lsmLeveledMutex;
+    std::atomic<uint64_t> lsmUserWrites{0};
+    std::atomic<uint64_t> lsmFlushWrites{0};
+    std::atomic<uint64_t> lsmCompactionWrites{0};
+
+    // deleted page ranges (first, count) for the caller to trim, see nextTrim
+    std::deque<std::pair<uint64_t, uint64_t>> readyTrims;
+    std::mutex trimMutex;
+
 public:
     PatternGen(Options options)
         : options(options)
         , pattern(stringToPattern(options.patternString))
-        , zipfSampler(options.logicalPages, options.skewFactor)
+        , zipfSampler(pattern == Pattern::Zipf ? options.logicalPages : 1, options.skewFactor)
     {
         shuffle = !options.patternString.contains("-noshuffle");
         if (pattern == Pattern::Sequential
@@ -204,7 +325,11 @@ public:
             || pattern == Pattern::ZNS
             || pattern == Pattern::NoWA
             || pattern == Pattern::LSM
-            || pattern == Pattern::LSMNoWA ) {
+            || pattern == Pattern::LSMNoWA
+            || pattern == Pattern::Schedule
+            || pattern == Pattern::Tenants
+            || pattern == Pattern::DBOutOfPlace
+            || pattern == Pattern::LSMLeveled) {
             shuffle = options.patternString.contains("-shuffle");
         }
 
@@ -214,26 +339,30 @@ public:
         init();
     }
 
-    PatternGen(Pattern pattern, uint64_t logicalPages, double skewFactor = 1.0, bool shuffle = true)
+    PatternGen(Pattern pattern, uint64_t logicalPages, double skewFactor = 1.0, bool shuffle = true, string shuffleMode = "vector")
         : options{}
         , pattern(pattern)
         , shuffle(shuffle)
-        , zipfSampler(logicalPages, skewFactor)
+        , zipfSampler(pattern == Pattern::Zipf ? logicalPages : 1, skewFactor)
     {
         options.logicalPages = logicalPages;
         options.skewFactor = skewFactor;
+        options.shuffleMode = shuffleMode;
         rndPage = std::uniform_int_distribution<uint64_t>(0, options.logicalPages - 1);
         init();
     }
 
     std::string patternDetails() const {
         std::string details;
-        if (pattern == Pattern::Zones || pattern == Pattern::SeqZones) {
+        if (pattern == Pattern::Zones || pattern == Pattern::SeqZones || pattern == Pattern::Tenants) {
             details = options.zonesString;
         } else if (pattern == Pattern::Beta) {
             details = "a:" + std::to_string(options.alpha) + " b:" + std::to_string(options.beta);
-        } else if (pattern == Pattern::Zipf || pattern == Pattern::FioZipf) {
+        } else if (pattern == Pattern::Zipf) {
             details = std::to_string(options.skewFactor);
+        } else if (pattern == Pattern::FioZipf) {
+            details = (options.patternString.contains("fiopareto") ? "pareto:" : "zipf:") + std::to_string(options.skewFactor)
+                      + " seed:" + std::to_string(options.fioSeed);
         } else if (pattern == Pattern::ZNS || pattern == Pattern::NoWA) {
             details = "activeZones:" + std::to_string(options.znsActiveZones) +
                       " pagesPerZone:" + std::to_string(options.znsPagesPerZone);
@@ -260,6 +389,16 @@ public:
                 " | wal:["  + std::to_string(walStart) + ".." + std::to_string(walEnd - 1) + "]";
         } else if (pattern == Pattern::Sequential) {
             details = "Sequential init begin" ;
+        } else if (pattern == Pattern::Schedule) {
+            details = options.scheduleString;
+        } else if (pattern == Pattern::DBOutOfPlace) {
+            details = "DB(pages:" + std::to_string(dbPages) + " levels:" + std::to_string(dbLevelStart.size()) +
+                      " buffer:" + std::to_string(dbFrameCapacity) + " skew:" + std::to_string(options.dbSkew) +
+                      " segments:" + std::to_string(dbSegments) + "x" + std::to_string(options.dbSegmentPages) + ")";
+        } else if (pattern == Pattern::LSMLeveled) {
+            details = "LSMLeveled(keys:" + std::to_string(lsmKeys) + " levels:" + std::to_string(lsmLevelFiles.size()) +
+                      " memtable:" + std::to_string(options.lsmMemtablePages) + " sst:" + std::to_string(options.lsmSstPages) +
+                      " ratio:" + std::to_string(options.lsmRatio) + ")";
         }
 
         return details;
@@ -272,6 +411,7 @@ public:
 
         pgOptions.patternString = getEnv("PATTERN", "uniform");
         pgOptions.zonesString = getEnv("ZONES", "s0.9 f0.1 uniform s0.1 f0.9 uniform");
+        pgOptions.shuffleMode = getEnv("SHUFFLE", "vector");
 
         pgOptions.alpha = std::stod(getEnv("ALPHA", "1"));
         pgOptions.beta  = std::stod(getEnv("BETA",  "1"));
@@ -282,43 +422,68 @@ public:
         pgOptions.sectorSize = std::stoull(getEnv("SECTOR_SIZE", "512"));
         pgOptions.znsActiveZones = std::stoull(getEnv("ZNS_ACTIVE_ZONES", "4"));
         pgOptions.znsPagesPerZone = getBytesFromString(getEnv("ZNS_ZONE_SIZE", "1G")) / pageSize;
+        pgOptions.scheduleString = getEnv("SCHEDULE", "");
 
         pgOptions.skewFactor = 1.0;
         if (pgOptions.patternString.contains("zipf")) {
             pgOptions.skewFactor = std::stod(getEnv("ZIPF", "1.0"));
+        } else if (pgOptions.patternString.contains("fiopareto")) {
+            pgOptions.skewFactor = std::stod(getEnv("PARETO", "0.2"));
         }
-        if (!pgOptions.patternString.contains("zones")) {
+        pgOptions.fioSeed = std::stoul(getEnv("FIO_SEED", "1"));
+        pgOptions.dbFill = getEnv("DB_FILL", (float)pgOptions.dbFill);
+        pgOptions.dbBuffer = getEnv("DB_BUFFER", (float)pgOptions.dbBuffer);
+        pgOptions.dbFanout = getEnv("DB_FANOUT", (float)pgOptions.dbFanout);
+        pgOptions.dbSkew = getEnv("DB_SKEW", (float)pgOptions.dbSkew);
+        pgOptions.dbSegmentPages = getBytesFromString(getEnv("DB_SEGMENT", "16M")) / pageSize;
+        pgOptions.dbCleanFree = getEnv("DB_CLEAN_FREE", (float)pgOptions.dbCleanFree);
+        pgOptions.lsmFill = getEnv("LSM_FILL", (float)pgOptions.lsmFill);
+        pgOptions.lsmMemtablePages = getBytesFromString(getEnv("LSM_MEMTABLE", "64M")) / pageSize;
+        pgOptions.lsmSstPages = getBytesFromString(getEnv("LSM_SST", "64M")) / pageSize;
+        pgOptions.lsmL1Pages = getBytesFromString(getEnv("LSM_L1", "256M")) / pageSize;
+        pgOptions.lsmRatio = getEnv("LSM_RATIO", (float)pgOptions.lsmRatio);
+        pgOptions.lsmL0Trigger = getEnv("LSM_L0", (float)pgOptions.lsmL0Trigger);
+        pgOptions.lsmLevels = getEnv("LSM_LEVELS", (float)pgOptions.lsmLevels);
+        if (pgOptions.patternString.contains("tenants")) {
+            pgOptions.zonesString = getEnv("TENANTS", "s0.5 f0.5 uniform s0.5 f0.5 uniform");
+        } else if (!pgOptions.patternString.contains("zones")) {
             pgOptions.zonesString.clear();
         }
         return pgOptions;
     }
 
     static Pattern stringToPattern(std::string pattern) {
+        if (pattern.contains("schedule"))   return Pattern::Schedule;
+        if (pattern.contains("tenants"))    return Pattern::Tenants;
         if (pattern.contains("sequential")) return Pattern::Sequential;
         if (pattern.contains("uniform"))    return Pattern::Uniform;
         if (pattern.contains("beta"))       return Pattern::Beta;
         if (pattern.contains("seqzones"))   return Pattern::SeqZones;
         if (pattern.contains("zones"))      return Pattern::Zones;
         if (pattern.contains("fiozipf"))    return Pattern::FioZipf;
+        if (pattern.contains("fiopareto"))  return Pattern::FioZipf;
         if (pattern.contains("zipf"))       return Pattern::Zipf;
         if (pattern.contains("trace"))      return Pattern::Traces;
         if (pattern.contains("zns"))        return Pattern::ZNS;
         if (pattern.contains("lsmnowa"))    return Pattern::LSMNoWA;
+        if (pattern.contains("lsmleveled")) return Pattern::LSMLeveled;
         if (pattern.contains("nowa"))       return Pattern::NoWA;
         if (pattern.contains("lsm"))        return Pattern::LSM;
+        if (pattern.contains("dboutofplace")) return Pattern::DBOutOfPlace;
         ensurem(false, "pattern does not exist: " + pattern);
         return Pattern::Undefined;
     }
 
     void init() {
         if (pattern == Pattern::FioZipf) {
-            generateFioZipfTraces(options.skewFactor, options.logicalPages, options.totalWrites);
+            const auto dist = options.patternString.contains("fiopareto") ? FioZipf::Distribution::Pareto : FioZipf::Distribution::Zipf;
+            fioGen = std::make_unique<FioZipf>(dist, options.logicalPages, options.skewFactor, options.fioSeed);
         } else if (pattern == Pattern::Traces) {
             traceFilePath = getTraceFilePath(options.patternString);
             validateAndLoadTraceFiles(traceFilePath, options.patternString,
                                       options.sectorSize, options.logicalPages,
                                       options.pageSize, inputTraces);
-        } else if (pattern == Pattern::Zones) {
+        } else if (pattern == Pattern::Zones || pattern == Pattern::Tenants) {
             parseAndInitZoneAccessPattern();
         } else if (pattern == Pattern::SeqZones) {
             parseAndInitSeqZoneAccessPattern();
@@ -330,33 +495,61 @@ public:
             parseAndInitLSMAccessPattern();
         }else if (pattern == Pattern::LSMNoWA) {
             parseAndInitLSMNoWAAccessPattern();
+        } else if (pattern == Pattern::Schedule) {
+            parseAndInitSchedule();
+        } else if (pattern == Pattern::DBOutOfPlace) {
+            initDBOutOfPlace();
+        } else if (pattern == Pattern::LSMLeveled) {
+            initLSMLeveled();
         }
 
         if (shuffle) {
-            updatePattern.resize(options.logicalPages);
-            std::iota(updatePattern.begin(), updatePattern.end(), 0ULL);
             std::random_device rd;
             std::mt19937_64 g(rd());
-            std::shuffle(updatePattern.begin(), updatePattern.end(), g);
+            if (options.shuffleMode == "feistel") {
+                permutation.emplace(options.logicalPages, g());
+                if (getEnv("SHUFFLE_CHECK", 0.0f) > 0) {
+                    permutation->verify();
+                    std::cout << "PatternGen: feistel shuffle is a permutation of " << options.logicalPages << " pages" << std::endl;
+                }
+            } else {
+                ensurem(options.shuffleMode == "vector", "SHUFFLE must be vector or feistel");
+                updatePattern.resize(options.logicalPages);
+                std::iota(updatePattern.begin(), updatePattern.end(), 0ULL);
+                std::shuffle(updatePattern.begin(), updatePattern.end(), g);
+            }
         }
     }
 
+    // lifetime hint of a write, noHint if the pattern does not know better
+    static constexpr uint8_t noHint = 0xFF;
+
     int64_t accessPatternGenerator(std::mt19937_64& gen) {
+        uint8_t hint;
+        return accessPatternGenerator(gen, hint);
+    }
+
+    // hint: WAL 0 / data 1 / compaction 2 for LSM and LSMNoWA, the zone for ZNS and NoWA,
+    // the zone (tenant) index for zones patterns, the phase for schedules, for
+    // DBOutOfPlace 0 for the cleaner's relocations, 1 + the B-tree level for evictions and
+    // for LSMLeveled 0 for the WAL, 1 + the level for SST writes
+    int64_t accessPatternGenerator(std::mt19937_64& gen, uint8_t& hint) {
         uint64_t page = 0;
+        hint = noHint;
 
         if (pattern == Pattern::Sequential) {
             page = seq++ % options.logicalPages;
         } else if (pattern == Pattern::Uniform) {
             page = rndPage(gen);
-        } else if (pattern == Pattern::SeqZones || pattern == Pattern::Zones) {
-            page = accessZonesGenerator(gen);
+        } else if (pattern == Pattern::SeqZones || pattern == Pattern::Zones || pattern == Pattern::Tenants) {
+            page = accessZonesGenerator(gen, hint);
         } else if (pattern == Pattern::Beta) {
             double beta_val = beta_distribution(gen, options.alpha, options.beta);
             page = (uint64_t)(beta_val * (options.logicalPages - 1));
         } else if (pattern == Pattern::Zipf) {
             page = zipfSampler.sample(gen) - 1;
         } else if (pattern == Pattern::FioZipf) {
-            page = getPageFromFIOTrace();
+            page = fioNext();
         } else if (pattern == Pattern::Traces) {
             page = getPageFromParsedTrace(inputTraces, traceIndex, chunkSize);
         } else if (pattern == Pattern::ZNS) {
@@ -365,30 +558,237 @@ public:
             } else {
                 page = accessZNS(gen);
             }
+            hint = (page / options.znsPagesPerZone) % noHint;
         } else if (pattern == Pattern::NoWA) {
             if (seq < (options.znsPagesPerZone * (znsZones - (znsZones % options.znsActiveZones)))) {
                 page = seq++ % options.logicalPages;
             } else {
                 page = accessNoWA(gen);
             }
+            hint = (page / options.znsPagesPerZone) % noHint;
         } else if (pattern == Pattern::LSM) {
             page = accessLSM(gen);
+            hint = page >= lsmWalOffset ? 0 : 1;
         }  else if (pattern == Pattern::LSMNoWA) {
             page = accessLSMNoWA(gen);
+            hint = page >= lsmWalOffset2 ? 0 : page >= lsmRegion1Offset ? 2 : 1;
+        } else if (pattern == Pattern::Schedule) {
+            page = accessSchedule(gen, hint);
+        } else if (pattern == Pattern::DBOutOfPlace) {
+            page = accessDBOutOfPlace(gen, hint);
+        } else if (pattern == Pattern::LSMLeveled) {
+            page = accessLSMLeveled(hint);
         } else {
             throw std::runtime_error("Error: pattern not implemented.");
         }
 
-        if (shuffle) {
-            if (!(page < updatePattern.size())) raise(SIGINT);
-            page = updatePattern.at(page);
-        }
-
+        page = shuffled(page);
         ensure(page < options.logicalPages);
         return (int64_t)page;
     }
 
+    uint64_t shuffled(uint64_t page) const {
+        if (!shuffle) {
+            return page;
+        }
+        if (permutation) {
+            return (*permutation)(page);
+        }
+        if (!(page < updatePattern.size())) raise(SIGINT);
+        return updatePattern.at(page);
+    }
+
+    // a run of consecutive pages [first, first + n), n in [1, maxPages]: sequential and trace
+    // patterns (without shuffling) hand out what the next accesses would, the others one page
+    uint64_t accessPatternRun(std::mt19937_64& gen, uint64_t maxPages, uint64_t& first, uint8_t& hint) {
+        if (shuffle || maxPages <= 1 || (pattern != Pattern::Sequential && pattern != Pattern::Traces)) {
+            first = accessPatternGenerator(gen, hint);
+            return 1;
+        }
+        hint = noHint;
+        if (pattern == Pattern::Sequential) {
+            uint64_t s = seq.load();
+            uint64_t n;
+            do {
+                first = s % options.logicalPages;
+                n = std::min(maxPages, options.logicalPages - first);
+            } while (!seq.compare_exchange_weak(s, s + n));
+            return n;
+        }
+        // a trace request was split into pages, take them while they stay in the loaded chunk
+        first = getPageFromParsedTrace(inputTraces, traceIndex, chunkSize);
+        uint64_t n = 1;
+        while (n < maxPages && traceIndex % chunkSize != 0 && inputTraces[(traceIndex + 1) % chunkSize] == first + n) {
+            traceIndex++;
+            n++;
+        }
+        return n;
+    }
+
+    // Tenants: same syntax as zones, but every zone is a tenant with its own contiguous
+    // LBA range (not shuffled across tenants). Returns the first page of each tenant.
+    std::vector<uint64_t> tenantOffsets() const {
+        std::vector<uint64_t> offsets;
+        if (pattern == Pattern::Tenants) {
+            for (auto& az : accessZones) {
+                offsets.push_back(az.offset);
+            }
+        }
+        return offsets;
+    }
+
+    // patterns that model the storage engine above the device: pages it writes per page
+    // of user data, DBOutOfPlace: (evictions + cleaning) / evictions, LSMLeveled:
+    // (WAL + flushes + compactions) / WAL; 0 for the others or before the first write
+    bool hasHostWA() const { return pattern == Pattern::DBOutOfPlace || pattern == Pattern::LSMLeveled; }
+    double hostWA() const {
+        uint64_t user = 0;
+        uint64_t total = 0;
+        if (pattern == Pattern::DBOutOfPlace) {
+            user = dbEvictionWrites;
+            total = user + dbCleanWrites;
+        } else if (pattern == Pattern::LSMLeveled) {
+            user = lsmUserWrites;
+            total = user + lsmFlushWrites + lsmCompactionWrites;
+        }
+        return user == 0 ? 0.0 : (double)total / user;
+    }
+
+    // pops a page range the pattern deleted (zone reset, file deletion, cleaned segment);
+    // false if there is none. Drain it after each accessPatternGenerator and before writing
+    // the page it returned: a range may be rewritten by that very write
+    bool nextTrim(uint64_t& first, uint64_t& count) {
+        std::unique_lock<std::mutex> guard(trimMutex);
+        if (readyTrims.empty()) {
+            return false;
+        }
+        std::tie(first, count) = readyTrims.front();
+        readyTrims.pop_front();
+        return true;
+    }
+
+    // index of the schedule phase the next access belongs to
+    uint64_t currentPhase() const {
+        if (phases.empty()) {
+            return 0;
+        }
+        uint64_t w = scheduleWrites % scheduleLength;
+        uint64_t i = 0;
+        while (w >= phases[i].writes) {
+            w -= phases[i++].writes;
+        }
+        return i;
+    }
+
 private:
+    // in the page space of the writes: shuffled, a range falls apart into single pages
+    void emitTrim(uint64_t first, uint64_t count) {
+        std::unique_lock<std::mutex> guard(trimMutex);
+        if (!shuffle) {
+            readyTrims.push_back({first, count});
+            return;
+        }
+        for (uint64_t p = first; p < first + count; p++) {
+            readyTrims.push_back({shuffled(p), 1});
+        }
+    }
+
+    // next queued write, trims queued before it become ready on the way; false (and the
+    // queue emptied) when there is none left
+    bool nextPendingWrite(std::vector<PendingOp>& ops, size_t& pos, uint64_t& page, uint8_t& hint) {
+        while (pos < ops.size()) {
+            const PendingOp op = ops[pos++];
+            if (op.count > 0) {
+                emitTrim(op.page, op.count);
+                continue;
+            }
+            page = op.page;
+            hint = op.hint;
+            return true;
+        }
+        ops.clear();
+        pos = 0;
+        return false;
+    }
+
+    // ---------------- Schedule ----------------
+    // SCHEDULE="<device writes> <pattern> [drift<d>]; ..." with pattern one of uniform,
+    // zipf<skew>, sequential, beta<alpha>:<beta> or zones <ZONES syntax>. drift<d> moves
+    // the hot set by d * logical capacity per device write (before shuffling).
+    void parseAndInitSchedule() {
+        ensurem(!options.scheduleString.empty(), "PATTERN=schedule needs SCHEDULE");
+        phases.clear();
+        std::stringstream phaseStream(options.scheduleString);
+        std::string phaseSpec;
+        while (std::getline(phaseStream, phaseSpec, ';')) {
+            std::stringstream ss(phaseSpec);
+            std::string token;
+            if (!(ss >> token)) {
+                continue;
+            }
+            Phase ph;
+            ph.spec = phaseSpec;
+            ph.writes = (uint64_t)(std::stod(token) * options.logicalPages);
+            ensurem(ph.writes > 0, "schedule phase without writes: " + phaseSpec);
+            std::string pat;
+            std::string zones;
+            while (ss >> token) {
+                if (token.rfind("drift", 0) == 0) {
+                    ph.drift = std::stod(token.substr(5));
+                } else if (pat.empty()) {
+                    pat = token;
+                } else {
+                    zones += token + " ";
+                }
+            }
+            const uint64_t n = options.logicalPages;
+            if (pat == "uniform") {
+                ph.gen = std::make_unique<PatternGen>(Pattern::Uniform, n, 1.0, false);
+            } else if (pat == "sequential") {
+                ph.gen = std::make_unique<PatternGen>(Pattern::Sequential, n, 1.0, false);
+            } else if (pat.rfind("zipf", 0) == 0) {
+                ph.gen = std::make_unique<PatternGen>(Pattern::Zipf, n, std::stod(pat.substr(4)), false);
+            } else if (pat.rfind("beta", 0) == 0 || pat == "zones") {
+                Options sub;
+                sub.logicalPages = n;
+                sub.pageSize = options.pageSize;
+                sub.patternString = pat.substr(0, 4) == "beta" ? "beta-noshuffle" : "zones-noshuffle";
+                if (pat == "zones") {
+                    sub.zonesString = zones;
+                } else {
+                    auto colon = pat.find(':');
+                    ensurem(colon != std::string::npos, "schedule: beta<alpha>:<beta> expected: " + pat);
+                    sub.alpha = std::stod(pat.substr(4, colon - 4));
+                    sub.beta = std::stod(pat.substr(colon + 1));
+                }
+                ph.gen = std::make_unique<PatternGen>(sub);
+            } else {
+                ensurem(false, "schedule: pattern not supported: " + pat);
+            }
+            scheduleLength += ph.writes;
+            phases.push_back(std::move(ph));
+        }
+        ensurem(!phases.empty(), "empty SCHEDULE");
+    }
+
+    uint64_t accessSchedule(std::mt19937_64& gen, uint8_t& hint) {
+        uint64_t w = scheduleWrites++ % scheduleLength;
+        for (uint64_t i = 0; i < phases.size(); i++) {
+            auto& ph = phases[i];
+            if (w < ph.writes) {
+                hint = i % noHint;
+                uint64_t page = ph.gen->accessPatternGenerator(gen);
+                if (ph.drift > 0) {
+                    page = (page + (uint64_t)(w * ph.drift)) % options.logicalPages;
+                }
+                return page;
+            }
+            w -= ph.writes;
+        }
+        ensure(false);
+        return 0;
+    }
+
     // ---------------- Zones pattern init ----------------
     double sumFreq = 0.0;
     std::vector<AccessZone> accessZones;
@@ -466,7 +866,7 @@ private:
         ensurem(pageCount == assigned2, "Pages not correctly assigned");
 
         for (auto& h : accessZones) {
-            h.subGen = std::make_unique<PatternGen>(h.pattern, h.count, h.skewFactor, h.shuffle);
+            h.subGen = std::make_unique<PatternGen>(h.pattern, h.count, h.skewFactor, h.shuffle, options.shuffleMode);
         }
     }
 
@@ -489,7 +889,7 @@ private:
         initZoneAccessPattern();
     }
 
-    uint64_t accessZonesGenerator(std::mt19937_64& gen) {
+    uint64_t accessZonesGenerator(std::mt19937_64& gen, uint8_t& hint) {
         std::uniform_real_distribution<double> realDist(0, sumFreq);
         double randFreq = realDist(gen);
 
@@ -501,6 +901,7 @@ private:
         }
 
         auto& az = accessZones.at(randZoneId);
+        hint = randZoneId % noHint;
         return az.offset + (uint64_t)az.subGen->accessPatternGenerator(gen);
     }
 
@@ -624,6 +1025,11 @@ private:
     // ---------------- Active-slot accounting ----------------
     void setSlotZone(uint64_t slot, int64_t zoneId, uint64_t offset) {
         int64_t old = znsActiveZoneIds[slot];
+        // opening a zone at offset 0 resets it, unless another slot is still writing it
+        if (zoneId >= 0 && offset == 0 && zoneId != old &&
+            std::find(znsActiveZoneIds.begin(), znsActiveZoneIds.end(), zoneId) == znsActiveZoneIds.end()) {
+            emitTrim((uint64_t)zoneId * options.znsPagesPerZone, options.znsPagesPerZone);
+        }
         if (old < 0 && zoneId >= 0) activeCount++;
         if (old >= 0 && zoneId < 0) activeCount--;
         znsActiveZoneIds[slot] = zoneId;
@@ -665,7 +1071,7 @@ private:
         imbalancedGroups.clear();
         posInImbalanced.clear();
 
-        zipfZoneSampler = std::make_unique<RejectionInversionZipfSampler>(znsZones, 0.4);
+        zipfZoneSampler = std::make_unique<ZipfSampler>(znsZones, 0.4);
     }
 
     void parseAndInitNoWAAccessPattern() {
@@ -699,7 +1105,7 @@ private:
         imbalancedGroups.clear();
         posInImbalanced.clear();
 
-        zipfZoneSampler = std::make_unique<RejectionInversionZipfSampler>(znsZones, 0.4);
+        zipfZoneSampler = std::make_unique<ZipfSampler>(znsZones, 0.4);
     }
 
     // ---------------- Zone selection helpers ----------------
@@ -793,7 +1199,7 @@ private:
 
         for (uint64_t i = 0; i < options.znsActiveZones; ++i) setSlotZone(i, -1, 0);
 
-        if (!zipfZoneSampler) zipfZoneSampler = std::make_unique<RejectionInversionZipfSampler>(znsZones, 0.4);
+        if (!zipfZoneSampler) zipfZoneSampler = std::make_unique<ZipfSampler>(znsZones, 0.4);
 
         uint64_t newZone = 0;
 
@@ -883,7 +1289,7 @@ private:
 
         if (znsActiveZoneIds[slot] < 0) {
             if (countActiveZonesFast() < curmaxopenzonecnt) {
-                if (!zipfZoneSampler) zipfZoneSampler = std::make_unique<RejectionInversionZipfSampler>(znsZones, 0.4);
+                if (!zipfZoneSampler) zipfZoneSampler = std::make_unique<ZipfSampler>(znsZones, 0.4);
                 uint64_t newZone;
                 do {
                     newZone = zipfZoneSampler->sample(gen) - 1;
@@ -913,7 +1319,7 @@ private:
         }
 
         if (znsActiveZoneIds[slot] < 0) {
-            if (!zipfZoneSampler) zipfZoneSampler = std::make_unique<RejectionInversionZipfSampler>(znsZones, 0.4);
+            if (!zipfZoneSampler) zipfZoneSampler = std::make_unique<ZipfSampler>(znsZones, 0.4);
             uint64_t newZone;
             do { newZone = zipfZoneSampler->sample(gen) - 1; } while (newZone >= znsZones);
             setSlotZone((uint64_t)slot, (int64_t)newZone, 0);
@@ -998,7 +1404,7 @@ private:
         imbalancedGroups.clear();
         posInImbalanced.clear();
 
-        zipfZoneSampler = std::make_unique<RejectionInversionZipfSampler>(znsZones, 0.4);
+        zipfZoneSampler = std::make_unique<ZipfSampler>(znsZones, 0.4);
     }
 
     uint64_t accessLSM(std::mt19937_64& gen) {
@@ -1110,7 +1516,7 @@ void parseAndInitLSMNoWAAccessPattern() {
     imbalancedGroups.clear();
     posInImbalanced.clear();
 
-    zipfZoneSampler = std::make_unique<RejectionInversionZipfSampler>(znsZones, 0.4);
+    zipfZoneSampler = std::make_unique<ZipfSampler>(znsZones, 0.4);
 }
 
 // ===========================
@@ -1163,69 +1569,421 @@ uint64_t accessLSMNoWA(std::mt19937_64& gen) {
 }
 
 
-    // ---------------- Misc ----------------
-    static double beta_distribution(std::mt19937_64& gen, double alpha, double beta) {
-        std::gamma_distribution<> X(alpha, 1.0);
-        std::gamma_distribution<> Y(beta, 1.0);
-        double x = X(gen);
-        double y = Y(gen);
-        return x / (x + y);
+    // ---------------- DBOutOfPlace ----------------
+    // Write path of an out-of-place page store (LeanStore-like): transactions update B-tree
+    // leaves, a leaf change reaches the parent with probability 2/fanout (splits), and so on
+    // up the tree. Dirty pages sit in a buffer pool and are written back when CLOCK evicts
+    // them, to the end of the open log segment, which invalidates their old location. When
+    // the free segments run low, the cleaner relocates the live pages of the segment with the
+    // fewest of them into its own open segment. The device sees evictions and relocations.
+    void initDBOutOfPlace() {
+        if (options.dbSegmentPages == 0) {
+            options.dbSegmentPages = 16ULL * 1024 * 1024 / options.pageSize;
+        }
+        ensurem(options.dbFanout >= 2, "DB_FANOUT must be at least 2");
+        ensurem(options.dbFill > 0 && options.dbFill < 1, "DB_FILL must be in (0, 1)");
+        ensurem(options.dbCleanFree >= 1, "DB_CLEAN_FREE must be at least 1");
+        const uint64_t seg = options.dbSegmentPages;
+        dbSegments = options.logicalPages / seg;
+        ensurem(dbSegments * seg < dbNone, "dboutofplace: too many pages");
+
+        // leaves such that leaves plus all inner levels fit into the database size
+        const uint64_t target = std::max<uint64_t>(1, options.logicalPages * options.dbFill);
+        uint64_t leaves = target;
+        std::vector<uint64_t> levelSize;
+        while (true) {
+            levelSize = {leaves};
+            uint64_t total = leaves;
+            while (levelSize.back() > 1) {
+                levelSize.push_back((levelSize.back() + options.dbFanout - 1) / options.dbFanout);
+                total += levelSize.back();
+            }
+            if (total <= target) {
+                dbPages = total;
+                break;
+            }
+            leaves -= total - target;
+        }
+        dbLevelStart.clear();
+        uint64_t start = 0;
+        for (uint64_t size : levelSize) {
+            dbLevelStart.push_back(start);
+            start += size;
+        }
+        const uint64_t dataSegments = (dbPages + seg - 1) / seg;
+        ensurem(dataSegments + options.dbCleanFree + 2 < dbSegments, "dboutofplace: DB_FILL too high for " + std::to_string(dbSegments) + " segments");
+
+        // bulk load: the pages in order from LBA 0
+        dbLoc.resize(dbPages);
+        dbOwner.assign(dbSegments * seg, dbNone);
+        dbSegmentValid.assign(dbSegments, 0);
+        for (uint64_t p = 0; p < dbPages; p++) {
+            dbLoc[p] = p;
+            dbOwner[p] = p;
+            dbSegmentValid[p / seg]++;
+        }
+        dbSegmentFree.assign(dbSegments, 0);
+        dbFreeSegments.clear();
+        for (uint64_t s = dbSegments; s > dataSegments; s--) {
+            dbFreeSegments.push_back(s - 1);
+            dbSegmentFree[s - 1] = 1;
+        }
+        for (int stream : {DbUser, DbClean}) {
+            dbOpenSegment[stream] = dbTakeFreeSegment();
+            dbOpenPos[stream] = 0;
+        }
+
+        dbFrameCapacity = std::max<uint64_t>(1, dbPages * options.dbBuffer);
+        dbFrame.assign(dbPages, dbNone);
+        dbFramePage.clear();
+        dbFrameRef.clear();
+        dbFramePage.reserve(dbFrameCapacity);
+        dbFrameRef.reserve(dbFrameCapacity);
+        dbClockHand = 0;
+
+        dbSplit = std::bernoulli_distribution(std::min(1.0, 2.0 / options.dbFanout));
+        dbLeafDist = std::uniform_int_distribution<uint64_t>(0, leaves - 1);
+        if (options.dbSkew > 0) {
+            dbLeafSampler = std::make_unique<ZipfSampler>(leaves, options.dbSkew);
+        }
+        dbPending.clear();
+        dbPendingPos = 0;
     }
 
-    void generateFioZipfTraces(double alpha, uint64_t n, uint64_t accesses) {
-        const std::string filename = "fiotrace";
-        if (fs::exists(filename)) fs::remove(filename);
+    uint64_t accessDBOutOfPlace(std::mt19937_64& gen, uint8_t& hint) {
+        std::unique_lock<std::mutex> guard(dbMutex);
+        uint64_t lba;
+        while (!nextPendingWrite(dbPending, dbPendingPos, lba, hint)) {
+            dbUpdate(gen);
+        }
+        return lba;
+    }
 
-        std::ofstream outfile(filename, std::ios::app);
-        std::string command =
-            "../shared/genzipf " + std::to_string(alpha) + " " +
-            std::to_string(n) + " " + std::to_string(accesses) +
-            " >> " + filename;
+    void dbUpdate(std::mt19937_64& gen) {
+        uint64_t page = dbLeafSampler ? dbLeafSampler->sample(gen) - 1 : dbLeafDist(gen);
+        for (uint64_t level = 0;; level++) {
+            dbDirty(page);
+            if (level + 1 == dbLevelStart.size() || !dbSplit(gen)) {
+                break;
+            }
+            page = dbLevelStart[level + 1] + (page - dbLevelStart[level]) / options.dbFanout;
+        }
+    }
 
-        int rc = std::system(command.c_str());
-        if (rc == -1) {
-            std::cerr << "system() failed: " << std::strerror(errno) << "\n";
+    void dbDirty(uint64_t page) {
+        if (dbFrame[page] != dbNone) {
+            dbFrameRef[dbFrame[page]] = 1;
             return;
         }
-        if (rc != 0) {
-            std::cerr << "genzipf returned non-zero status: " << rc << "\n";
+        uint64_t frame;
+        if (dbFramePage.size() < dbFrameCapacity) {
+            frame = dbFramePage.size();
+            dbFramePage.push_back(page);
+            dbFrameRef.push_back(1);
+        } else {
+            while (dbFrameRef[dbClockHand]) {
+                dbFrameRef[dbClockHand] = 0;
+                dbClockHand = (dbClockHand + 1) % dbFrameCapacity;
+            }
+            frame = dbClockHand;
+            dbClockHand = (dbClockHand + 1) % dbFrameCapacity;
+            const uint64_t victim = dbFramePage[frame];
+            dbFrame[victim] = dbNone;
+            const uint64_t level = std::upper_bound(dbLevelStart.begin(), dbLevelStart.end(), victim) - dbLevelStart.begin() - 1;
+            dbWriteOut(victim, DbUser, 1 + std::min<uint64_t>(level, noHint - 2));
+            dbFramePage[frame] = page;
+            dbFrameRef[frame] = 1;
+        }
+        dbFrame[page] = frame;
+    }
+
+    void dbWriteOut(uint64_t page, DbStream stream, uint8_t hint) {
+        const uint64_t seg = options.dbSegmentPages;
+        const uint64_t old = dbLoc[page];
+        dbOwner[old] = dbNone;
+        dbSegmentValid[old / seg]--;
+        const uint64_t lba = dbAppend(stream);
+        dbLoc[page] = lba;
+        dbOwner[lba] = page;
+        dbSegmentValid[lba / seg]++;
+        dbPending.push_back({lba, 0, hint});
+        if (stream == DbUser) {
+            dbEvictionWrites++;
+        } else {
+            dbCleanWrites++;
         }
-        outfile.close();
     }
 
-    const std::string fiotTracefile = "fiotrace";
-    uint64_t lastPos = 0;
+    uint64_t dbTakeFreeSegment() {
+        ensurem(!dbFreeSegments.empty(), "dboutofplace: out of free segments, lower DB_FILL");
+        const uint64_t s = dbFreeSegments.back();
+        dbFreeSegments.pop_back();
+        dbSegmentFree[s] = 0;
+        return s;
+    }
 
-    bool fetchPagesFromFIOTrace() {
-        std::ifstream inFile{fiotTracefile};
-        inFile.seekg((std::streampos)lastPos);
-        if (!inFile.is_open()) {
-            std::cerr << "Error: Unable to open file " << fiotTracefile << " for reading input traces.\n";
-            return false;
+    uint64_t dbAppend(DbStream stream) {
+        const uint64_t seg = options.dbSegmentPages;
+        if (dbOpenPos[stream] == seg) {
+            if (stream == DbUser) {
+                while (dbFreeSegments.size() <= options.dbCleanFree) {
+                    dbCleanSegment();
+                }
+            }
+            dbOpenSegment[stream] = dbTakeFreeSegment();
+            dbOpenPos[stream] = 0;
+        }
+        return dbOpenSegment[stream] * seg + dbOpenPos[stream]++;
+    }
+
+    // greedy: the closed segment with the fewest live pages
+    void dbCleanSegment() {
+        const uint64_t seg = options.dbSegmentPages;
+        uint64_t victim = dbSegments;
+        for (uint64_t s = 0; s < dbSegments; s++) {
+            if (dbSegmentFree[s] || s == dbOpenSegment[DbUser] || s == dbOpenSegment[DbClean]) {
+                continue;
+            }
+            if (victim == dbSegments || dbSegmentValid[s] < dbSegmentValid[victim]) {
+                victim = s;
+            }
         }
+        ensurem(victim < dbSegments && dbSegmentValid[victim] < seg, "dboutofplace: no segment to clean, lower DB_FILL");
+        for (uint64_t lba = victim * seg; lba < (victim + 1) * seg; lba++) {
+            if (dbOwner[lba] != dbNone) {
+                dbWriteOut(dbOwner[lba], DbClean, 0);
+            }
+        }
+        ensure(dbSegmentValid[victim] == 0);
+        dbPending.push_back({victim * seg, seg, 0});
+        dbSegmentFree[victim] = 1;
+        dbFreeSegments.push_back(victim);
+    }
 
-        inputTraces.clear();
-        inputTraces.reserve(chunkSize);
+    // ---------------- LSMLeveled ----------------
+    // Leveled LSM-tree (RocksDB-like) at page granularity. Every page of updates is appended
+    // to the WAL and goes into the memtable; a full memtable is flushed to an L0 file and its
+    // WAL file deleted. LSM_L0 files in L0 are merged with all of L1; a level above its target
+    // (L1 * ratio^(n-1)) merges its next file (round-robin by key) with the overlapping files
+    // of the level below. Keys are updated uniformly, so merge outputs are sized by the
+    // expected union of independent key sets. Deleted files are handed out as trims.
+    void initLSMLeveled() {
+        const uint64_t defaultPages = 64ULL * 1024 * 1024 / options.pageSize;
+        if (options.lsmMemtablePages == 0) options.lsmMemtablePages = defaultPages;
+        if (options.lsmSstPages == 0) options.lsmSstPages = defaultPages;
+        if (options.lsmL1Pages == 0) options.lsmL1Pages = 4 * defaultPages;
+        ensurem(options.lsmFill > 0 && options.lsmFill < 1, "LSM_FILL must be in (0, 1)");
+        ensurem(options.lsmRatio > 1, "LSM_RATIO must be larger than 1");
+        ensurem(options.lsmL0Trigger >= 1, "LSM_L0 must be at least 1");
+        lsmKeys = std::max<uint64_t>(1, options.logicalPages * options.lsmFill);
+        lsmSlotPages = std::min(options.lsmMemtablePages, options.lsmSstPages);
+
+        // the last level holds all keys, the ones above it are sized down from there by
+        // LSM_RATIO (RocksDB's dynamic level sizing), with as many levels as it takes to get
+        // L1 within LSM_L1
+        uint64_t levels = options.lsmLevels;
+        if (levels == 0) {
+            levels = 2;
+            for (double l1 = lsmKeys; l1 > options.lsmL1Pages; l1 /= options.lsmRatio) {
+                levels++;
+            }
+        }
+        ensurem(levels >= 2, "LSM_LEVELS must be at least 2 (L0 and one level)");
+        lsmLevelTarget.assign(levels, 0);
+        for (uint64_t level = levels - 2; level >= 1; level--) {
+            lsmLevelTarget[level] = std::max<uint64_t>(1, lsmKeys / std::pow(options.lsmRatio, levels - 1 - level));
+        }
+        lsmLevelTarget[levels - 1] = UINT64_MAX;
+        lsmLevelFiles.assign(levels, {});
+        lsmLevelPages.assign(levels, 0);
+        lsmCursor.assign(levels, 0.0);
+
+        lsmFreeSlots.clear();
+        for (uint64_t slot = 0; slot < options.logicalPages / lsmSlotPages; slot++) {
+            lsmFreeSlots.insert(slot);
+        }
+        // steady state without writing it: the last level has every key, the others are full
+        for (uint64_t level = levels - 1; level >= 1; level--) {
+            const uint64_t pages = level == levels - 1 ? lsmKeys : lsmLevelTarget[level];
+            const uint64_t files = (pages + options.lsmSstPages - 1) / options.lsmSstPages;
+            for (uint64_t i = 0; i < files; i++) {
+                LsmFile f{(double)i / files, (double)(i + 1) / files, pages / files + (i < pages % files), {}};
+                lsmAllocate(f);
+                lsmLevelFiles[level].push_back(f);
+                lsmLevelPages[level] += f.pages;
+            }
+        }
+        // room for L0, two WALs and the largest merge
+        const uint64_t sparePages = (options.lsmL0Trigger + 2) * options.lsmMemtablePages
+                                    + (uint64_t)std::ceil(2 * (options.lsmRatio + 1)) * options.lsmSstPages + lsmLevelTarget[1];
+        ensurem(lsmFreeSlots.size() * lsmSlotPages >= sparePages, "lsmleveled: " + std::to_string(lsmFreeSlots.size() * lsmSlotPages) +
+                " free pages, " + std::to_string(sparePages) + " needed, lower LSM_FILL or the file sizes");
+        lsmWal = LsmFile{};
+        lsmPending.clear();
+        lsmPendingPos = 0;
+    }
 
-        uint64_t trace;
-        size_t count = 0;
-        while (count < chunkSize && inFile >> trace) {
-            inputTraces.push_back(trace);
-            count++;
+    // first fit, slot by slot
+    void lsmAllocate(LsmFile& f) {
+        while (f.slots.size() * lsmSlotPages < f.pages) {
+            ensurem(!lsmFreeSlots.empty(), "lsmleveled: out of space, lower LSM_FILL");
+            f.slots.push_back(*lsmFreeSlots.begin());
+            lsmFreeSlots.erase(lsmFreeSlots.begin());
         }
-        lastPos = (uint64_t)inFile.tellg();
-        inFile.close();
-        return !inputTraces.empty();
     }
 
-    uint64_t getPageFromFIOTrace() {
-        if (traceIndex % chunkSize == 0) {
-            if (!fetchPagesFromFIOTrace()) {
-                throw std::runtime_error("Error: Unable to fetch more pages from the parsed trace file.");
+    uint64_t lsmPageOf(const LsmFile& f, uint64_t i) const {
+        return f.slots[i / lsmSlotPages] * lsmSlotPages + i % lsmSlotPages;
+    }
+
+    uint64_t accessLSMLeveled(uint8_t& hint) {
+        std::unique_lock<std::mutex> guard(lsmLeveledMutex);
+        uint64_t page;
+        while (!nextPendingWrite(lsmPending, lsmPendingPos, page, hint)) {
+            lsmLeveledStep();
+        }
+        return page;
+    }
+
+    void lsmLeveledStep() {
+        if (lsmWal.pages % lsmSlotPages == 0) {
+            lsmWal.pages++;
+            lsmAllocate(lsmWal);
+        } else {
+            lsmWal.pages++;
+        }
+        lsmPending.push_back({lsmPageOf(lsmWal, lsmWal.pages - 1), 0, 0});
+        lsmUserWrites++;
+        if (lsmWal.pages < options.lsmMemtablePages) {
+            return;
+        }
+        // memtable switch: flush, then drop the WAL
+        const double m = options.lsmMemtablePages;
+        LsmFile l0{0.0, 1.0, std::max<uint64_t>(1, std::llround(lsmKeys * -std::expm1(-m / lsmKeys))), {}};
+        lsmAllocate(l0);
+        lsmWriteFile(l0, 0);
+        lsmFlushWrites += l0.pages;
+        lsmLevelPages[0] += l0.pages;
+        lsmLevelFiles[0].push_back(std::move(l0));
+        lsmDeleteFile(lsmWal);
+        lsmWal = LsmFile{};
+        lsmCompact();
+    }
+
+    void lsmWriteFile(const LsmFile& f, uint64_t level) {
+        const uint8_t hint = 1 + std::min<uint64_t>(level, noHint - 2);
+        for (uint64_t i = 0; i < f.pages; i++) {
+            lsmPending.push_back({lsmPageOf(f, i), 0, hint});
+        }
+    }
+
+    void lsmDeleteFile(const LsmFile& f) {
+        for (uint64_t i = 0; i < f.slots.size(); i++) {
+            lsmPending.push_back({f.slots[i] * lsmSlotPages, std::min(lsmSlotPages, f.pages - i * lsmSlotPages), 0});
+            lsmFreeSlots.insert(f.slots[i]);
+        }
+    }
+
+    void lsmCompact() {
+        const uint64_t last = lsmLevelFiles.size() - 1;
+        bool compacted = true;
+        while (compacted) {
+            compacted = false;
+            if (lsmLevelFiles[0].size() >= options.lsmL0Trigger) {
+                std::vector<LsmFile> inputs = std::move(lsmLevelFiles[0]);
+                lsmLevelFiles[0].clear();
+                lsmLevelPages[0] = 0;
+                lsmMerge(inputs, 1);
+                compacted = true;
+                continue;
+            }
+            for (uint64_t level = 1; level < last; level++) {
+                if (lsmLevelPages[level] > lsmLevelTarget[level]) {
+                    auto& files = lsmLevelFiles[level];
+                    auto it = std::find_if(files.begin(), files.end(), [&](const LsmFile& f) { return f.lo >= lsmCursor[level]; });
+                    if (it == files.end()) {
+                        it = files.begin();
+                    }
+                    std::vector<LsmFile> inputs{std::move(*it)};
+                    files.erase(it);
+                    lsmLevelPages[level] -= inputs[0].pages;
+                    lsmCursor[level] = inputs[0].hi;
+                    lsmMerge(inputs, level + 1);
+                    compacted = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // merges inputs (upper level) with the overlapping files of level, writes the output as
+    // SST files of that level and deletes all inputs
+    void lsmMerge(const std::vector<LsmFile>& upper, uint64_t level) {
+        double lo = 1.0, hi = 0.0;
+        for (auto& f : upper) {
+            lo = std::min(lo, f.lo);
+            hi = std::max(hi, f.hi);
+        }
+        auto& files = lsmLevelFiles[level];
+        std::vector<LsmFile> lower;
+        for (auto it = files.begin(); it != files.end();) {
+            if (it->hi > lo && it->lo < hi) {
+                lower.push_back(std::move(*it));
+                lsmLevelPages[level] -= it->pages;
+                it = files.erase(it);
+            } else {
+                ++it;
             }
         }
-        if (traceIndex >= options.totalWrites) return 0;
-        return inputTraces[traceIndex++ % chunkSize];
+        uint64_t lowerPages = 0;
+        for (auto& f : lower) {
+            lo = std::min(lo, f.lo);
+            hi = std::max(hi, f.hi);
+            lowerPages += f.pages;
+        }
+        // expected union of independent uniform key sets within the range
+        const double keys = std::max(1.0, lsmKeys * (hi - lo));
+        double merged = 0;
+        for (auto& f : upper) {
+            merged += f.pages - merged * f.pages / keys;
+        }
+        merged += lowerPages - merged * lowerPages / keys;
+        const uint64_t total = std::max<uint64_t>(1, std::llround(std::min(merged, keys)));
+
+        const uint64_t outputs = (total + options.lsmSstPages - 1) / options.lsmSstPages;
+        for (uint64_t i = 0; i < outputs; i++) {
+            LsmFile f{lo + (hi - lo) * i / outputs, lo + (hi - lo) * (i + 1) / outputs, total / outputs + (i < total % outputs), {}};
+            lsmAllocate(f);
+            lsmWriteFile(f, level);
+            lsmCompactionWrites += f.pages;
+            lsmLevelPages[level] += f.pages;
+            auto pos = std::upper_bound(files.begin(), files.end(), f.lo, [](double key, const LsmFile& b) { return key < b.lo; });
+            files.insert(pos, std::move(f));
+        }
+        for (auto& f : upper) {
+            lsmDeleteFile(f);
+        }
+        for (auto& f : lower) {
+            lsmDeleteFile(f);
+        }
+    }
+
+    // ---------------- Misc ----------------
+    static double beta_distribution(std::mt19937_64& gen, double alpha, double beta) {
+        std::gamma_distribution<> X(alpha, 1.0);
+        std::gamma_distribution<> Y(beta, 1.0);
+        double x = X(gen);
+        double y = Y(gen);
+        return x / (x + y);
+    }
+
+    uint64_t fioNext() {
+        std::unique_lock<std::mutex> guard(fioMutex);
+        if (fioBatchPos == fioBatch.size()) {
+            fioGen->next(fioBatch, chunkSize);
+            fioBatchPos = 0;
+        }
+        return fioBatch[fioBatchPos++];
     }
 };
 
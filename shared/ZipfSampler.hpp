@@ -0,0 +1,106 @@
+#pragma once
+
+#include "RejectionInversionZipf.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Zipf over [1, n] with P(k) ~ k^-exponent, table based for moderate n.
+//
+// The alias table (Vose) answers a draw with one random number, one multiply and one
+// table lookup, no transcendental functions and no rejection loop. It takes 8 bytes per
+// element, so above tableMaxElements the sampler falls back to rejection inversion.
+class AliasZipfSampler {
+    struct Entry {
+        uint32_t threshold; // keep k if the coin is below, 2^32 scale
+        uint32_t alias;
+    };
+    std::vector<Entry> table;
+    uint64_t n;
+
+public:
+    AliasZipfSampler(uint64_t n, double exponent) : n(n) {
+        if (n == 0 || n > UINT32_MAX) {
+            throw std::invalid_argument("AliasZipfSampler: number of elements out of range: " + std::to_string(n));
+        }
+        std::vector<double> prob(n);
+        double sum = 0;
+        for (uint64_t k = 0; k < n; k++) {
+            prob[k] = std::pow((double)(k + 1), -exponent);
+            sum += prob[k];
+        }
+        std::vector<uint32_t> small, large;
+        for (uint64_t k = 0; k < n; k++) {
+            prob[k] = prob[k] * n / sum;
+            (prob[k] < 1.0 ? small : large).push_back(k);
+        }
+        table.resize(n);
+        while (!small.empty() && !large.empty()) {
+            const uint32_t s = small.back();
+            small.pop_back();
+            const uint32_t l = large.back();
+            table[s] = {toThreshold(prob[s]), l};
+            prob[l] -= 1.0 - prob[s];
+            if (prob[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // left overs are 1.0 up to rounding
+        for (uint32_t k : large) {
+            table[k] = {UINT32_MAX, k};
+        }
+        for (uint32_t k : small) {
+            table[k] = {UINT32_MAX, k};
+        }
+    }
+
+    static uint32_t toThreshold(double p) {
+        return p >= 1.0 ? UINT32_MAX : (uint32_t)(p * 4294967296.0);
+    }
+
+    long sample(std::mt19937_64& rng) const {
+        // high half of r * n picks the column, the low half is uniform within it
+        const unsigned __int128 m = (unsigned __int128)rng() * n;
+        const uint64_t k = m >> 64;
+        const uint32_t coin = (uint64_t)m >> 32;
+        const Entry& e = table[k];
+        return (coin < e.threshold ? k : e.alias) + 1;
+    }
+
+    uint64_t memory() const { return table.size() * sizeof(Entry); }
+};
+
+class ZipfSampler {
+public:
+    enum class Kind { Auto, Table, Rejection };
+    static constexpr uint64_t tableMaxElements = 1ull << 20; // 8 MB table
+
+private:
+    std::optional<AliasZipfSampler> aliasSampler;
+    std::optional<RejectionInversionZipfSampler> rejectionSampler;
+
+public:
+    ZipfSampler(long numberOfElements, double exponent, Kind kind = Kind::Auto) {
+        if (kind == Kind::Auto) {
+            kind = (uint64_t)numberOfElements <= tableMaxElements ? Kind::Table : Kind::Rejection;
+        }
+        if (kind == Kind::Table) {
+            aliasSampler.emplace(numberOfElements, exponent);
+        } else {
+            rejectionSampler.emplace(numberOfElements, exponent);
+        }
+    }
+
+    // in [1, numberOfElements]
+    long sample(std::mt19937_64& rng) {
+        return aliasSampler ? aliasSampler->sample(rng) : rejectionSampler->sample(rng);
+    }
+
+    bool usesTable() const { return aliasSampler.has_value(); }
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "SSD.hpp"
+#include "Env.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+// Lifetime projection from the erase counts so far: the host writes done per erase,
+// scaled to PE_LIMIT erases. "mean" assumes perfect wear leveling, "worst" that the
+// device is worn out when its most erased block reaches the limit. DWPD is relative to
+// the logical capacity over WARRANTY_YEARS.
+//
+// endurance.csv gets one row per repetition, eraseHist.csv the non-empty buckets of the
+// erase count histogram.
+class EnduranceReport {
+   const SSD& ssd;
+   const std::string hash;
+   const double peLimit;
+   const double warrantyYears;
+   std::ofstream summary;
+   std::ofstream hist;
+
+public:
+   EnduranceReport(const SSD& ssd, std::string hash)
+      : ssd(ssd), hash(hash), peLimit(getEnv("PE_LIMIT", 3000.0f)), warrantyYears(getEnv("WARRANTY_YEARS", 5.0f)) {
+      summary.open("endurance.csv");
+      hist.open("eraseHist.csv");
+      if (!summary.is_open() || !hist.is_open()) {
+         throw std::runtime_error("could not open endurance.csv / eraseHist.csv");
+      }
+      summary << "endurance,hash,rep,hostTB,eraseMin,eraseMax,eraseMean,peLimit,tbwMean,tbwWorst,dwpdMean,dwpdWorst" << std::endl;
+      hist << "eraseHist,hash,rep,eraseCount,blocks" << std::endl;
+   }
+
+   void writeRep(uint64_t rep) {
+      const auto erases = ssd.eraseCountStats();
+      const double hostBytes = (double)ssd.hostWritesTotal() * ssd.pageSize;
+      const double userBytesPerYear = (double)ssd.logicalPages * ssd.pageSize * 365;
+      auto tbw = [&](double erasesSoFar) { return erasesSoFar > 0 ? hostBytes / erasesSoFar * peLimit / 1e12 : 0; };
+      const double tbwMean = tbw(erases.mean);
+      const double tbwWorst = tbw(erases.max);
+      std::string prefix = hash + "," + std::to_string(rep) + ",";
+      summary << "endurance," << prefix << hostBytes / 1e12 << "," << erases.min << "," << erases.max << "," << erases.mean << "," << peLimit
+              << "," << tbwMean << "," << tbwWorst << "," << tbwMean * 1e12 / (userBytesPerYear * warrantyYears)
+              << "," << tbwWorst * 1e12 / (userBytesPerYear * warrantyYears) << std::endl;
+      const auto& buckets = ssd.eraseHistogram();
+      for (uint64_t e = erases.min; e < buckets.size(); e++) {
+         if (buckets[e] > 0) {
+            hist << "eraseHist," << prefix << e << "," << buckets[e] << "\n";
+         }
+      }
+      hist << std::flush;
+   }
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "SSD.hpp"
+#include "Timing.hpp"
+#include "Env.hpp"
+
+#include <cstdint>
+#include <iostream>
+
+// When the GC policy runs, on top of its own "no free block left" trigger.
+//
+// Below the low watermark, a host write first runs GC rounds until the watermark is
+// reached again (foreground, the write pays for it). Every IDLE_EVERY ms of simulated
+// time the host pauses for IDLE_FOR ms; the first GC_IDLE_BUDGET fraction of that pause
+// is used for background GC until the high watermark is reached. GC rounds only run if
+// full blocks hold at least one block worth of invalid pages, otherwise a round would
+// free nothing.
+template <typename GCAlgo>
+class GCScheduler {
+public:
+   struct Config {
+      uint64_t lowWatermark = 0;   // free blocks, 0: policy default only
+      uint64_t highWatermark = 0;  // free blocks
+      uint64_t idleEvery = 0;      // ns, 0: no idle periods
+      uint64_t idleFor = 0;        // ns
+      double idleBudget = 1.0;
+
+      static Config fromEnv() {
+         Config c;
+         c.lowWatermark = getEnv("GC_LOW", 0.0f);
+         c.highWatermark = getEnv("GC_HIGH", 0.0f);
+         c.idleEvery = getEnv("IDLE_EVERY", 0.0f) * 1e6;
+         c.idleFor = getEnv("IDLE_FOR", 0.0f) * 1e6;
+         c.idleBudget = getEnv("GC_IDLE_BUDGET", 1.0f);
+         if (c.highWatermark < c.lowWatermark) {
+            c.highWatermark = c.lowWatermark;
+         }
+         return c;
+      }
+   };
+
+private:
+   GCAlgo& gc;
+   SSD& ssd;
+   TimingModel& timing;
+   const Config cfg;
+   uint64_t nextIdle;
+
+   bool canReclaim() const { return ssd.reclaimablePages() >= ssd.pagesPerZone; }
+
+public:
+   uint64_t fgSteps = 0;
+   uint64_t bgSteps = 0;
+   uint64_t idlePeriods = 0;
+
+   GCScheduler(GCAlgo& gc, SSD& ssd, TimingModel& timing, Config cfg)
+      : gc(gc), ssd(ssd), timing(timing), cfg(cfg), nextIdle(cfg.idleEvery) {}
+
+   // idle periods are in simulated time
+   bool needsTiming() const { return cfg.idleEvery > 0; }
+
+   void beforeHostWrite() {
+      while (gc.freeBlockCnt() < cfg.lowWatermark && canReclaim()) {
+         gc.gcStep();
+         fgSteps++;
+      }
+   }
+
+   // between two host operations
+   void afterHostOp() {
+      if (cfg.idleEvery == 0 || timing.now() < nextIdle) {
+         return;
+      }
+      const uint64_t idleStart = timing.now();
+      const uint64_t idleEnd = idleStart + cfg.idleFor;
+      const uint64_t budgetEnd = idleStart + cfg.idleFor * cfg.idleBudget;
+      while (gc.freeBlockCnt() < cfg.highWatermark && timing.latestDieBusy() < budgetEnd && canReclaim()) {
+         gc.gcStep();
+         bgSteps++;
+      }
+      timing.idleUntil(idleEnd);
+      nextIdle = timing.now() + cfg.idleEvery;
+      idlePeriods++;
+   }
+
+   void print(std::ostream& out) const {
+      out << "gc scheduler: low: " << cfg.lowWatermark << " high: " << cfg.highWatermark
+          << " idle every: " << cfg.idleEvery / 1e6 << "ms for: " << cfg.idleFor / 1e6 << "ms budget: " << cfg.idleBudget << std::endl;
+   }
+};
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "SSD.hpp"
+#include "WearLeveling.hpp"
 
 #include <cstdint>
 #include <fstream>
@@ -18,7 +19,8 @@ class GenerationalGC {
    int64_t currentWriteHead = -1;
    std::random_device rd;
    std::mt19937_64 gen{rd()};
-   std::list<uint64_t> freeBlocks;
+   FreeBlockPool freeBlocks{ssd};
+   StaticWearLeveler wearLeveler{ssd};
    std::map<int64_t, int64_t> gcWriteHeads;
 public:
    GenerationalGC(SSD& ssd) : ssd(ssd) {
@@ -32,18 +34,38 @@ public:
       return "gen";
    }
    void writePage(uint64_t pageId) {
-      // select write block based on TT
+      openWriteHead();
+      ssd.writePage(pageId, currentWriteHead);
+   }
+   void writePages(uint64_t firstPageId, uint64_t count) {
+      ssd.writePages(firstPageId, count, [&]() { return openWriteHead(); });
+   }
+   uint64_t openWriteHead() {
       if (!ssd.blocks()[currentWriteHead].canWrite()) {
          ensure(ssd.blocks()[currentWriteHead].writePos() == ssd.pagesPerZone); 
          if (freeBlocks.empty()) {
             performGC();
          }
-         currentWriteHead = freeBlocks.front();
-         freeBlocks.pop_front();
+         uint64_t next = wearLeveler.check(freeBlocks, [&](uint64_t b) {
+            if ((int64_t)b == currentWriteHead) {
+               return true;
+            }
+            for (auto& [generation, head] : gcWriteHeads) {
+               if ((int64_t)b == head) {
+                  return true;
+               }
+            }
+            return false;
+         });
+         if (next == SSD::unused) {
+            next = freeBlocks.front();
+            freeBlocks.pop_front();
+         }
+         currentWriteHead = next;
          //gtstd::cout << "freeBlock gen:" <<  ssd.blocks()[currentWriteHead].gcGeneration << " wp: " << ssd.blocks()[currentWriteHead].writePos() << std::endl;
          ensure(ssd.blocks()[currentWriteHead].canWrite());
       }
-      ssd.writePage(pageId, currentWriteHead);
+      return currentWriteHead;
    }
    uint64_t singleGreedy() {
       uint64_t minIdx;
@@ -114,6 +136,12 @@ public:
       gcWriteHeads[gcBlockGeneration] = gcBlock;
       freeBlocks.push_back(freeBlock);
    }
+   uint64_t freeBlockCnt() const { return freeBlocks.size(); }
+   uint64_t trimRange(uint64_t first, uint64_t count) { return ssd.trimRange(first, count); }
+   void gcStep() { performGC(); }
+   void registerMetrics(MetricsRegistry& m) {
+      m.intGauge("gcWriteHeads", [this]() { return (uint64_t)gcWriteHeads.size(); });
+   }
    void stats() {
       std::cout << "GenerationalGC stats: " << std::endl;
    }
@@ -4,6 +4,9 @@
 #pragma once
 
 #include "SSD.hpp"
+#include "WearLeveling.hpp"
+#include "Env.hpp"
+#include "PatternGen.hpp"
 
 #include <fstream>
 #include <csignal>
@@ -21,7 +24,27 @@ class GreedyGC {
    std::random_device rd;
    std::mt19937_64 gen{rd()};
    std::uniform_int_distribution<uint64_t> rndBlockDist;
-   std::list<uint64_t> freeBlocks;
+   FreeBlockPool freeBlocks{ssd};
+   StaticWearLeveler wearLeveler{ssd};
+   // HINT_STREAMS > 0: hinted host writes go to one open block per stream (hint % streams)
+   std::vector<uint64_t> streamBlocks;
+   uint64_t hintedWrites = 0;
+
+   bool isOpenBlock(uint64_t b) const {
+      return b == currentBlock || (int64_t)b == currentGCBlock || std::find(streamBlocks.begin(), streamBlocks.end(), b) != streamBlocks.end();
+   }
+   uint64_t nextBlock() {
+      if (freeBlocks.empty()) {
+         performGC();
+      }
+      uint64_t b = wearLeveler.check(freeBlocks, [&](uint64_t b) { return isOpenBlock(b); });
+      if (b == SSD::unused) {
+         b = freeBlocks.front();
+         freeBlocks.pop_front();
+      }
+      ensure(ssd.blocks()[b].canWrite());
+      return b;
+   }
 public:
    GreedyGC(SSD& ssd, int k = 0, bool twoR = false) : ssd(ssd), k(k), rndBlockDist(0, ssd.zones-1), simpleTwoR(twoR) {
       for (uint64_t z=0; z < ssd.zones; z++) {
@@ -29,6 +52,14 @@ public:
       }
       currentBlock = freeBlocks.front();
       freeBlocks.pop_front();
+      const uint64_t streams = getEnv("HINT_STREAMS", 0.0f);
+      if (streams >= ssd.zones / 2) {
+         throw std::runtime_error("HINT_STREAMS must be below half the erase blocks");
+      }
+      for (uint64_t s = 0; s < streams; s++) {
+         streamBlocks.push_back(freeBlocks.front());
+         freeBlocks.pop_front();
+      }
    }
    string name() {
       if (simpleTwoR) {
@@ -39,16 +70,31 @@ public:
       }
       return "greedy-k" + std::to_string(k);
    }
-   void writePage(uint64_t pageId) {
+   uint64_t openBlock() {
       if (!ssd.blocks()[currentBlock].canWrite()) {
-         if (freeBlocks.empty()) {
-            performGC();
-         }
-         currentBlock = freeBlocks.front();
-         freeBlocks.pop_front();
-         ensure(ssd.blocks()[currentBlock].canWrite());
+         currentBlock = nextBlock();
+      }
+      return currentBlock;
+   }
+   void writePage(uint64_t pageId) {
+      ssd.writePage(pageId, openBlock());
+   }
+   // consecutive host pages, unhinted
+   void writePages(uint64_t firstPageId, uint64_t count) {
+      ssd.writePages(firstPageId, count, [&]() { return openBlock(); });
+   }
+   // host write with a PatternGen lifetime hint
+   void writePage(uint64_t pageId, uint8_t hint) {
+      if (streamBlocks.empty() || hint == iob::PatternGen::noHint) {
+         writePage(pageId);
+         return;
+      }
+      uint64_t& block = streamBlocks[hint % streamBlocks.size()];
+      if (!ssd.blocks()[block].canWrite()) {
+         block = nextBlock();
       }
-      ssd.writePage(pageId, currentBlock);
+      ssd.writePage(pageId, block);
+      hintedWrites++;
    }
    uint64_t singleGreedy() {
       uint64_t minIdx;
@@ -75,7 +121,7 @@ public:
             int i = 0;
             do {
                uint64_t idx = rndBlockDist(gen);
-               if (ssd.blocks().at(idx).validCnt() < minCnt) {
+               if (ssd.blocks().at(idx).validCnt() < minCnt && std::find(streamBlocks.begin(), streamBlocks.end(), idx) == streamBlocks.end()) {
                   minIdx = idx;
                   minCnt = ssd.blocks()[idx].validCnt();
                }
@@ -93,6 +139,16 @@ public:
          freeBlocks.push_back(freeBlock);
       }
    }
+   uint64_t freeBlockCnt() const { return freeBlocks.size(); }
+   // host trim, the freed pages are reclaimed by the next GC of their blocks
+   uint64_t trimRange(uint64_t first, uint64_t count) { return ssd.trimRange(first, count); }
+   // one GC round, also when free blocks are left (background GC)
+   void gcStep() { performGC(); }
+   void registerMetrics(MetricsRegistry& metrics) {
+      if (!streamBlocks.empty()) {
+         metrics.counter("hintedWrites", hintedWrites);
+      }
+   }
    void stats() {
       // std::cout << "Greedy stats" << std::endl;
    }
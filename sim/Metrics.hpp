@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Per repetition stats of the simulator. SSD, GC policy and runBench register their
+// columns once, then every repetition becomes one row with a fixed schema:
+//
+//  - label:    constant for the run (pattern, gc, ...)
+//  - counter:  events of this repetition, the registry zeroes it after the row (resetCounters)
+//  - gauge:    value read when the row is written
+//  - histogram: expands to percentile gauges <prefix><p><suffix> and <prefix>max<suffix>
+//
+// STATS_FORMAT=csv (default) writes <name>.csv; bin writes <name>.bin: "SIMSTAT1", u32 column
+// count, per column u8 kind, u16 length + name (labels also u16 length + value), then per
+// row one 8 byte value per non-label column, u64 for counters and integer gauges, else double.
+class MetricsRegistry {
+public:
+   enum class Kind : uint8_t { Label = 0, Counter = 1, Gauge = 2, IntGauge = 3 };
+
+private:
+   struct Column {
+      std::string name;
+      Kind kind;
+      std::string label;
+      std::function<uint64_t()> readInt;
+      std::function<double()> read;
+      std::function<void()> reset;
+   };
+   std::vector<Column> columns;
+   std::ofstream out;
+   bool binary = false;
+
+   void add(Column c) {
+      if (out.is_open()) {
+         throw std::logic_error("metrics: column " + c.name + " registered after the schema was written");
+      }
+      columns.push_back(std::move(c));
+   }
+   void writeString(const std::string& s) {
+      uint16_t len = s.size();
+      out.write((const char*)&len, sizeof(len));
+      out.write(s.data(), len);
+   }
+
+public:
+   void label(std::string name, std::string value) { add({name, Kind::Label, value, nullptr, nullptr, nullptr}); }
+
+   template <typename T>
+   void counter(std::string name, T& value) {
+      static_assert(std::is_integral_v<T>);
+      add({name, Kind::Counter, "", [&value]() { return (uint64_t)value; }, nullptr, [&value]() { value = 0; }});
+   }
+   // one column per element: <prefix>0, <prefix>1, ...
+   template <typename T>
+   void counters(std::string prefix, std::vector<T>& values) {
+      for (uint64_t i = 0; i < values.size(); i++) {
+         add({prefix + std::to_string(i), Kind::Counter, "", [&values, i]() { return (uint64_t)values[i]; }, nullptr, [&values, i]() { values[i] = 0; }});
+      }
+   }
+   void gauge(std::string name, std::function<double()> read) { add({name, Kind::Gauge, "", nullptr, read, nullptr}); }
+   void intGauge(std::string name, std::function<uint64_t()> read) { add({name, Kind::IntGauge, "", read, nullptr, nullptr}); }
+
+   // Hist from shared/Hist.hpp, all zero while it is empty
+   template <typename H>
+   void histogram(std::string prefix, H& hist, std::vector<std::string> percentiles, std::string suffix) {
+      using V = decltype(hist.max);
+      auto column = [&](std::string name, std::function<V()> read) {
+         if constexpr (std::is_integral_v<V>) {
+            intGauge(name, [&hist, read]() { return hist.cnt > 0 ? (uint64_t)read() : 0; });
+         } else {
+            gauge(name, [&hist, read]() { return hist.cnt > 0 ? (double)read() : 0; });
+         }
+      };
+      for (auto& p : percentiles) {
+         std::string digits = p;
+         std::erase(digits, '.');
+         column(prefix + digits + suffix, [&hist, p]() { return hist.getPercentile(std::stof(p)); });
+      }
+      column(prefix + "max" + suffix, [&hist]() { return hist.max; });
+   }
+
+   // writes the schema, no columns can be added afterwards
+   void open(std::string name, std::string format) {
+      if (format != "csv" && format != "bin") {
+         throw std::runtime_error("STATS_FORMAT must be csv or bin");
+      }
+      binary = format == "bin";
+      std::string path = name + (binary ? ".bin" : ".csv");
+      out.open(path, binary ? std::ios::binary | std::ios::trunc : std::ios::trunc);
+      if (!out.is_open()) {
+         throw std::runtime_error("could not open " + path);
+      }
+      if (binary) {
+         out.write("SIMSTAT1", 8);
+         uint32_t cnt = columns.size();
+         out.write((const char*)&cnt, sizeof(cnt));
+         for (auto& c : columns) {
+            out.put((char)c.kind);
+            writeString(c.name);
+            if (c.kind == Kind::Label) {
+               writeString(c.label);
+            }
+         }
+      } else {
+         out << header() << "\n";
+      }
+      out << std::flush;
+   }
+
+   std::string header() const {
+      std::string h;
+      for (auto& c : columns) {
+         h += (h.empty() ? "" : ",") + c.name;
+      }
+      return h;
+   }
+
+   // reads all columns, appends the row to the file and returns it as csv
+   std::string writeRow() {
+      std::string csv;
+      for (auto& c : columns) {
+         std::string v;
+         uint64_t bits;
+         switch (c.kind) {
+            case Kind::Label:
+               v = c.label;
+               break;
+            case Kind::Counter:
+            case Kind::IntGauge:
+               bits = c.readInt();
+               v = std::to_string(bits);
+               break;
+            case Kind::Gauge: {
+               double d = c.read();
+               std::memcpy(&bits, &d, sizeof(d));
+               v = std::to_string(d);
+               break;
+            }
+         }
+         if (binary && c.kind != Kind::Label) {
+            out.write((const char*)&bits, sizeof(bits));
+         }
+         csv += (csv.empty() ? "" : ",") + v;
+      }
+      if (!binary) {
+         out << csv << "\n";
+      }
+      out << std::flush;
+      return csv;
+   }
+
+   void resetCounters() {
+      for (auto& c : columns) {
+         if (c.reset) {
+            c.reset();
+         }
+      }
+   }
+};
@@ -25,6 +25,18 @@ public:
       logicalWrites++;
       writesPerPage[pageId]++;
    }
+   void writePages(uint64_t firstPageId, uint64_t count) {
+      logicalWrites += count;
+      for (uint64_t p = firstPageId; p < firstPageId + count; p++) {
+         writesPerPage[p]++;
+      }
+   }
+   // no blocks, WA comes from the formula
+   uint64_t freeBlockCnt() const { return ssd.zones; }
+   // the formula assumes all logical pages live, trims are ignored
+   uint64_t trimRange(uint64_t, uint64_t) { return 0; }
+   void gcStep() {}
+   void registerMetrics(MetricsRegistry&) {}
    void stats() {
       std::vector<uint64_t> pages(writesPerPage);
       std::sort(pages.begin(), pages.end(), std::greater<>());
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "../shared/Exceptions.hpp"
+#include "Metrics.hpp"
 
 #include <cstdint>
 #include <list>
@@ -64,6 +65,7 @@ public:
       const std::vector<uint64_t>& ptl() const { return _ptl; }
       uint64_t validCnt() const { return _validCnt; }
       uint64_t writePos() const { return _writePos; }
+      uint64_t eraseCount() const { return _eraseCount; }
 
       const uint64_t pagesPerZone;
       const uint64_t blockId;
@@ -73,6 +75,7 @@ public:
       int64_t gcGeneration = 0;
       int64_t group = -1;
       bool writtenByGc = false;
+      uint64_t readsSinceErase = 0;
 
       Block(uint64_t pagesPerBlock, uint64_t blockId)
          : _ptl(pagesPerBlock)
@@ -90,6 +93,15 @@ public:
          return _writePos++;
       }
 
+      // appends count pages at the write position (an erased tail), returns the first position
+      uint64_t write(const uint64_t* logPageIds, uint64_t count) {
+         ensure(_writePos + count <= pagesPerZone);
+         std::copy(logPageIds, logPageIds + count, _ptl.begin() + _writePos);
+         _validCnt += count;
+         _writePos += count;
+         return _writePos - count;
+      }
+
       void setUnused(uint64_t pos) {
          ensure(_ptl[pos] != unused);
          _ptl[pos] = unused;
@@ -117,6 +129,7 @@ public:
          _eraseCount++;
          gcAge = _eraseAgeCounter++;
          writtenByGc = true;
+         readsSinceErase = 0;
       }
 
       void erase() {
@@ -127,6 +140,7 @@ public:
          writtenByGc = false;
          _validCnt = 0;
          group = -1;
+         readsSinceErase = 0;
       }
 
       void print() {
@@ -137,6 +151,11 @@ public:
       }
    };
 
+   // NAND operations, reported to the media hook (e.g. a timing model) with the physical
+   // page address; Erase gets the first page of the block
+   enum class MediaOp { HostRead, HostProgram, GcRead, GcProgram, Erase };
+   using MediaHook = std::function<void(MediaOp, uint64_t physAddr)>;
+
 private:
    // Global coarse lock to make SSD simulator thread-safe (debug/correctness first).
    // Many methods call each other; recursive_mutex avoids self-deadlock.
@@ -147,11 +166,65 @@ private:
    std::vector<uint64_t> _mappingUpdatedCnt; // stats
    std::vector<uint64_t> _mappingUpdatedGC;  // stats
    uint64_t _physWrites = 0;
+   uint64_t _hostReads = 0;
+   uint64_t _bufferReadHits = 0;
+   uint64_t _gcReads = 0;
+   uint64_t _trimmedPages = 0;
+   uint64_t _wlMigrations = 0;
+   uint64_t _wlMigratedPages = 0;
+   std::vector<uint64_t> _bulkPages; // writePages' programs, kept to reuse the allocation
 
    // stats
    uint64_t gcedNormalBlock = 0;
    uint64_t gcedColdBlock = 0;
 
+   MediaHook _mediaHook;
+   bool _hostWrite = false; // set while a host write (or write buffer eviction) programs a page
+   // read disturb: blocks that saw readDisturbThreshold reads since their last erase
+   uint64_t readDisturbThreshold = 0;
+   uint64_t _readDisturbBlocks = 0;
+
+   inline void mediaOp(MediaOp op, uint64_t physAddr) {
+      if (_mediaHook) {
+         _mediaHook(op, physAddr);
+      }
+   }
+
+   // erase count histogram, updated on every erase instead of scanning all blocks
+   std::vector<uint64_t> _eraseHist;   // erase count -> blocks
+   uint64_t _eraseMin = 0;
+   uint64_t _eraseMax = 0;
+   uint64_t _eraseTotal = 0;
+   uint64_t _hostWritesTotal = 0;      // never reset, for lifetime projections
+
+   // tenants own contiguous logical ranges, physical writes (host and GC) are attributed
+   // to the tenant of the page
+   std::vector<uint64_t> _tenantFirstPage;
+   std::vector<uint64_t> _tenantHostWrites;
+   std::vector<uint64_t> _tenantPhysWrites;
+
+   inline void countTenantPhysWrite(uint64_t logPage) {
+      if (!_tenantFirstPage.empty()) {
+         _tenantPhysWrites[tenantOf(logPage)]++;
+      }
+   }
+
+   // after the block's erase count went up by one
+   void blockErased(uint64_t blockId) {
+      const uint64_t e = _blocks[blockId].eraseCount();
+      if (e >= _eraseHist.size()) {
+         _eraseHist.resize(e + 1, 0);
+      }
+      _eraseHist[e - 1]--;
+      _eraseHist[e]++;
+      _eraseTotal++;
+      _eraseMax = std::max(_eraseMax, e);
+      while (_eraseHist[_eraseMin] == 0) {
+         _eraseMin++;
+      }
+      mediaOp(MediaOp::Erase, getAddr(blockId, 0));
+   }
+
    // --- Wear leveling configuration ---
    bool wearLevelingEnabled = false; // set true if you want WL on by default
    uint64_t wlDefaultLunCnt = 64;
@@ -223,12 +296,14 @@ private:
          uint64_t lba = oldB.ptl()[p];
          if (lba != unused) {
             // This is a "real move" (updates mapping, invalidates old phys page).
+            gcRead(getAddr(oldId, p));
             writePageWithoutCaching(lba, newB);
          }
       }
 
       // Erase old and return to free pool
       oldB.erase();
+      blockErased(oldId);
       oldB.gcGeneration = 0;
       wlPushFreeBlock(oldId);
 
@@ -254,6 +329,13 @@ public:
    const decltype(_mappingUpdatedCnt)& mappingUpdatedCnt() const { return _mappingUpdatedCnt; }
    const decltype(_mappingUpdatedGC)& mappingUpdatedGC() const { return _mappingUpdatedGC; }
    uint64_t physWrites() const { return _physWrites; }
+   uint64_t hostReads() const { return _hostReads; }
+   uint64_t bufferReadHits() const { return _bufferReadHits; }
+   uint64_t gcReads() const { return _gcReads; }
+   uint64_t trimmedPages() const { return _trimmedPages; }
+   uint64_t readDisturbBlocks() const { return _readDisturbBlocks; }
+   uint64_t wlMigrations() const { return _wlMigrations; }
+   uint64_t wlMigratedPages() const { return _wlMigratedPages; }
 
    void hackForOptimalWASetPhysWrites(uint64_t phyWrites) { _physWrites = phyWrites; }
 
@@ -277,6 +359,7 @@ public:
       for (uint64_t z = 0; z < zones; z++) {
          _blocks.emplace_back(Block(pagesPerZone, z));
       }
+      _eraseHist.assign(1, zones);
 
       // --- Wear leveling init ---
       wlLunCnt = std::min<uint64_t>(wlDefaultLunCnt, zones);
@@ -324,6 +407,83 @@ public:
    }
 
    uint64_t wearLevelingLunCnt() const { return wlLunCnt; }
+   // invalid pages in fully written blocks, what GC can get back without touching open blocks
+   uint64_t reclaimablePages() const {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+      uint64_t pages = 0;
+      for (auto& b : _blocks) {
+         if (b.fullyWritten()) {
+            pages += pagesPerZone - b.validCnt();
+         }
+      }
+      return pages;
+   }
+
+   struct EraseCountStats {
+      uint64_t min = 0;
+      uint64_t max = 0;
+      double mean = 0;
+   };
+   EraseCountStats eraseCountStats() const {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+      return {_eraseMin, _eraseMax, (double)_eraseTotal / _blocks.size()};
+   }
+   // blocks per erase count
+   const std::vector<uint64_t>& eraseHistogram() const { return _eraseHist; }
+   uint64_t hostWritesTotal() const { return _hostWritesTotal; }
+   // erases so far, GC events for sampling
+   uint64_t erases() const { return _eraseTotal; }
+
+   uint64_t lunCnt() const { return wlLunCnt; }
+   // pages are interleaved over the LUNs, like a superblock striped over all dies (the wear
+   // leveling pools group whole blocks by blockToLun instead)
+   uint64_t lunOfAddr(uint64_t physAddr) const { return physAddr % wlLunCnt; }
+
+   void setMediaHook(MediaHook hook) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+      _mediaHook = hook;
+   }
+
+   // first logical page of every tenant, ascending (PatternGen::tenantOffsets)
+   void setTenants(std::vector<uint64_t> firstPages) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+      ensure(std::is_sorted(firstPages.begin(), firstPages.end()));
+      _tenantFirstPage = firstPages;
+      _tenantHostWrites.assign(firstPages.size(), 0);
+      _tenantPhysWrites.assign(firstPages.size(), 0);
+   }
+   uint64_t tenantOf(uint64_t logPage) const {
+      return std::upper_bound(_tenantFirstPage.begin(), _tenantFirstPage.end(), logPage) - _tenantFirstPage.begin() - 1;
+   }
+   uint64_t tenantCnt() const { return _tenantFirstPage.size(); }
+
+   void setReadDisturbThreshold(uint64_t reads) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+      readDisturbThreshold = reads;
+   }
+
+   // Host read: the write buffer first, then the flash page _ltpMapping points to.
+   // Returns the physical address, or unused for buffer hits and never written pages.
+   uint64_t readPage(uint64_t logPage) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+
+      _hostReads++;
+      if (writeBufferMap.find(logPage) != writeBufferMap.end()) {
+         _bufferReadHits++;
+         return unused;
+      }
+      uint64_t addr = _ltpMapping.at(logPage);
+      if (addr == unused) {
+         return unused;
+      }
+      Block& block = _blocks[getZone(addr)];
+      block.readsSinceErase++;
+      if (readDisturbThreshold > 0 && block.readsSinceErase == readDisturbThreshold) {
+         _readDisturbBlocks++;
+      }
+      mediaOp(MediaOp::HostRead, addr);
+      return addr;
+   }
 
    uint64_t getZone(uint64_t physAddr) const { return physAddr / pagesPerZone; }
    uint64_t getPage(uint64_t physAddr) const { return physAddr % pagesPerZone; }
@@ -337,6 +497,11 @@ public:
    void writePage(uint64_t logPage, Block& block, int64_t group = -1) {
       std::lock_guard<std::recursive_mutex> g(ssdMutex);
 
+      _hostWrite = true;
+      _hostWritesTotal++;
+      if (!_tenantFirstPage.empty()) {
+         _tenantHostWrites[tenantOf(logPage)]++;
+      }
       if (writeBufferSize == 0) {
          writePageWithoutCaching(logPage, block, group);
       } else {
@@ -355,6 +520,133 @@ public:
             }
          }
       }
+      _hostWrite = false;
+   }
+
+   // Host write of [firstLogPage, firstLogPage + count), same result as writePage for each
+   // page. openBlock() returns the block for the next program (the policy's write head, full
+   // ones replaced); the pages that reach flash are programmed a block's free pages at a time.
+   template <typename OpenBlock>
+   void writePages(uint64_t firstLogPage, uint64_t count, OpenBlock&& openBlock, int64_t group = -1) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+
+      const uint64_t end = firstLogPage + count;
+      ensure(end <= logicalPages);
+      // a buffered page of the range changes the LRU order, take the page by page path
+      auto inRange = [&](uint64_t p) { return p >= firstLogPage && p < end; };
+      bool buffered = false;
+      if (writeBuffer.size() < count) {
+         buffered = std::any_of(writeBuffer.begin(), writeBuffer.end(), inRange);
+      } else {
+         for (uint64_t p = firstLogPage; p < end && !buffered; p++) {
+            buffered = writeBufferMap.contains(p);
+         }
+      }
+      if (buffered) {
+         for (uint64_t p = firstLogPage; p < end; p++) {
+            writePage(p, _blocks[openBlock()], group);
+         }
+         return;
+      }
+
+      _hostWritesTotal += count;
+      if (!_tenantFirstPage.empty()) {
+         for (uint64_t p = firstLogPage; p < end; p++) {
+            _tenantHostWrites[tenantOf(p)]++;
+         }
+      }
+      _bulkPages.clear();
+      uint64_t p = firstLogPage;
+      if (writeBufferSize == 0) {
+         p = end;
+      } else {
+         // the buffer ends up with the newest writeBufferSize - 1 pages, the others are
+         // evicted oldest first: the buffered ones, then the head of the range
+         const uint64_t keep = std::min<uint64_t>(writeBuffer.size() + count, writeBufferSize - 1);
+         uint64_t evict = writeBuffer.size() + count - keep;
+         for (; evict > 0 && !writeBuffer.empty(); evict--) {
+            _bulkPages.push_back(writeBuffer.back());
+            writeBufferMap.erase(writeBuffer.back());
+            writeBuffer.pop_back();
+         }
+         p += evict;
+         for (uint64_t q = p; q < end; q++) {
+            writeBuffer.push_front(q);
+            writeBufferMap[q] = writeBuffer.begin();
+         }
+      }
+      for (uint64_t q = firstLogPage; q < p; q++) {
+         _bulkPages.push_back(q);
+      }
+      for (uint64_t done = 0; done < _bulkPages.size();) {
+         // openBlock may run GC, which programs as GC
+         Block& block = _blocks[openBlock()];
+         const uint64_t n = std::min(_bulkPages.size() - done, block.pagesPerZone - block.writePos());
+         _hostWrite = true;
+         programPages(_bulkPages.data() + done, n, block, group);
+         _hostWrite = false;
+         done += n;
+      }
+   }
+
+   // writePageWithoutCaching for distinct pages that fit into the block: old locations are
+   // invalidated first, then the pages fill the block in one go
+   void programPages(const uint64_t* logPages, uint64_t count, Block& block, int64_t group = -1) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+
+      if (block.group == -1) {
+         block.group = group;
+      }
+      for (uint64_t i = 0; i < count; i++) {
+         const uint64_t addr = _ltpMapping[logPages[i]];
+         if (addr != unused) {
+            _blocks[getZone(addr)].setUnused(getPage(addr));
+         }
+      }
+      const uint64_t first = getAddr(block.blockId, block.write(logPages, count));
+      for (uint64_t i = 0; i < count; i++) {
+         _ltpMapping[logPages[i]] = first + i;
+         _mappingUpdatedCnt[logPages[i]]++;
+         countTenantPhysWrite(logPages[i]);
+         mediaOp(_hostWrite ? MediaOp::HostProgram : MediaOp::GcProgram, first + i);
+      }
+      _physWrites += count;
+   }
+
+   // Host trim (deallocate): drops the page from the write buffer and unmaps it, its flash
+   // page turns invalid like on an overwrite. Returns false if the page was not mapped.
+   bool trimPage(uint64_t logPage) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+
+      bool mapped = false;
+      auto it = writeBufferMap.find(logPage);
+      if (it != writeBufferMap.end()) {
+         writeBuffer.erase(it->second);
+         writeBufferMap.erase(it);
+         mapped = true;
+      }
+      uint64_t addr = _ltpMapping.at(logPage);
+      if (addr != unused) {
+         _blocks.at(getZone(addr)).setUnused(getPage(addr));
+         _ltpMapping[logPage] = unused;
+         mapped = true;
+      }
+      if (mapped) {
+         _trimmedPages++;
+      }
+      return mapped;
+   }
+
+   // pages [first, first + count), returns how many were mapped
+   uint64_t trimRange(uint64_t first, uint64_t count) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+
+      ensure(first + count <= logicalPages);
+      uint64_t trimmed = 0;
+      for (uint64_t p = first; p < first + count; p++) {
+         trimmed += trimPage(p);
+      }
+      return trimmed;
    }
 
    // only use from GC (or WL internal copies)
@@ -375,6 +667,30 @@ public:
       _ltpMapping[logPage] = getAddr(block.blockId, writePos);
       _mappingUpdatedCnt[logPage]++;
       _physWrites++;
+      countTenantPhysWrite(logPage);
+      mediaOp(_hostWrite ? MediaOp::HostProgram : MediaOp::GcProgram, getAddr(block.blockId, writePos));
+   }
+
+   // Zoned device (ZonedDevice.hpp): no write buffer and no device GC, the host picks the
+   // block. hostWrite=false for the host's own zone GC copies.
+   void writeZonePage(uint64_t logPage, uint64_t block, bool hostWrite) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+
+      if (hostWrite) {
+         _hostWritesTotal++;
+         if (!_tenantFirstPage.empty()) {
+            _tenantHostWrites[tenantOf(logPage)]++;
+         }
+      }
+      _hostWrite = hostWrite;
+      writePageWithoutCaching(logPage, _blocks.at(block));
+      _hostWrite = false;
+   }
+
+   // GC reads the valid page before it programs it somewhere else
+   void gcRead(uint64_t physAddr) {
+      _gcReads++;
+      mediaOp(MediaOp::GcRead, physAddr);
    }
 
    void eraseBlock(Block& block) {
@@ -382,6 +698,7 @@ public:
 
       uint64_t id = block.blockId;
       block.erase();
+      blockErased(id);
       if (wearLevelingEnabled) {
          wlPushFreeBlock(id);
       }
@@ -392,6 +709,7 @@ public:
 
       ensure(blockId < _blocks.size());
       _blocks[blockId].erase();
+      blockErased(blockId);
       ensure(_blocks[blockId].isErased());
       if (wearLevelingEnabled) {
          wlPushFreeBlock(blockId);
@@ -406,7 +724,13 @@ public:
    void compactBlock(Block& block) {
       std::lock_guard<std::recursive_mutex> g(ssdMutex);
 
+      for (uint64_t p = 0; p < block.writePos(); p++) {
+         if (block.ptl()[p] != unused) {
+            gcRead(getAddr(block.blockId, p));
+         }
+      }
       block.compactNoMappingUpdate();
+      blockErased(block.blockId);
       block.gcGeneration++;
       if (block.writtenByGc) {
          gcedColdBlock++;
@@ -421,6 +745,8 @@ public:
          _ltpMapping[logPage] = getAddr(block.blockId, p);
          _mappingUpdatedGC[logPage]++;
          _physWrites++;
+         countTenantPhysWrite(logPage);
+         mediaOp(MediaOp::GcProgram, getAddr(block.blockId, p));
       }
    }
 
@@ -440,6 +766,7 @@ public:
       uint64_t p = 0;
       while (p < pagesPerZone && destination.canWrite()) {
          if (source.ptl()[p] != unused) {
+            gcRead(getAddr(sourceId, p));
             writePageWithoutCaching(source.ptl()[p], destination);
          }
          p++;
@@ -470,6 +797,7 @@ public:
             auto [destinationId, groupId] = destinationFun(lba);
             Block& destination = _blocks[destinationId];
             if (destination.canWrite()) {
+               gcRead(getAddr(sourceId, p));
                writePageWithoutCaching(source.ptl()[p], destination, groupId);
             } else if (firstFullDestinationId == -1) {
                firstFullDestinationId = destinationId;
@@ -487,6 +815,22 @@ public:
       }
    }
 
+   // static wear leveling: moves the cold data of source onto destinations (worn blocks,
+   // filled in order, together they must have room for it), then erases source
+   void migrateBlock(uint64_t sourceId, const std::vector<uint64_t>& destinations) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+
+      Block& source = _blocks[sourceId];
+      const uint64_t physWritesBefore = _physWrites;
+      for (uint64_t d = 0; d < destinations.size() && moveValidPagesTo(sourceId, destinations[d]); d++) {
+      }
+      ensure(source.allInvalid());
+      eraseBlock(source);
+      source.gcGeneration = 0;
+      _wlMigrations++;
+      _wlMigratedPages += _physWrites - physWritesBefore;
+   }
+
    std::tuple<uint64_t, int64_t> compactUntilFreeBlock(
       int64_t gcBlockId,
       std::function<uint64_t()> nextBlock)
@@ -512,6 +856,7 @@ public:
 
       Block& nowFree = _blocks[victimId];
       nowFree.erase();
+      blockErased(victimId);
       nowFree.gcGeneration = 0;
       if (wearLevelingEnabled) {
          wlPushFreeBlock(victimId);
@@ -553,6 +898,7 @@ public:
 
       Block& nowFree = _blocks[victimId];
       nowFree.erase();
+      blockErased(victimId);
       nowFree.gcGeneration = 0;
       if (wearLevelingEnabled) {
          wlPushFreeBlock(victimId);
@@ -593,6 +939,8 @@ public:
    void resetPhysicalCounters() {
       std::lock_guard<std::recursive_mutex> g(ssdMutex);
       _physWrites = 0;
+      _wlMigrations = 0;
+      _wlMigratedPages = 0;
    }
 
    void printInfo() {
@@ -609,6 +957,33 @@ public:
       ensure(physicalPages % pagesPerZone == 0);
    }
 
+   // columns after runBench's own, the counters are reset per repetition by the registry
+   void registerMetrics(MetricsRegistry& m) {
+      m.intGauge("wlMigrations", [this]() { return _wlMigrations; });
+      m.intGauge("wlPages", [this]() { return _wlMigratedPages; });
+      m.intGauge("eraseMin", [this]() { return eraseCountStats().min; });
+      m.intGauge("eraseMax", [this]() { return eraseCountStats().max; });
+      m.gauge("eraseMean", [this]() { return eraseCountStats().mean; });
+      m.intGauge("physWrites", [this]() { return _physWrites; });
+      m.counter("gcReads", _gcReads);
+      m.counter("trimUnmapped", _trimmedPages);
+      m.counter("bufferReadHits", _bufferReadHits);
+      m.counter("gcedNormal", gcedNormalBlock);
+      m.counter("gcedCold", gcedColdBlock);
+      m.intGauge("writtenByGc", [this]() {
+         std::lock_guard<std::recursive_mutex> g(ssdMutex);
+         return (uint64_t)std::count_if(_blocks.begin(), _blocks.end(), [](const Block& b) { return b.writtenByGc; });
+      });
+      // WA gauges first, they read the counters before the registry resets them
+      for (uint64_t t = 0; t < _tenantFirstPage.size(); t++) {
+         m.gauge("tenantWA" + std::to_string(t), [this, t]() {
+            return _tenantHostWrites[t] > 0 ? (double)_tenantPhysWrites[t] / _tenantHostWrites[t] : 0;
+         });
+      }
+      m.counters("tenantHost", _tenantHostWrites);
+      m.counters("tenantPhys", _tenantPhysWrites);
+   }
+
    void stats() {
       std::lock_guard<std::recursive_mutex> g(ssdMutex);
 
@@ -653,9 +1028,6 @@ public:
          std::cout << "), ";
       }
       std::cout << "]\n";
-
-      gcedNormalBlock = 0;
-      gcedColdBlock = 0;
    }
 
    void printBlocksStats() {
@@ -701,8 +1073,19 @@ public:
       std::cout << "\n";
    }
 
-   void writeStatsFile([[maybe_unused]] std::string prefix) {
-      // left as-is
+   // per block state at the end of the run, the columnar version of printBlocksStats
+   void writeStatsFile(std::string prefix) {
+      std::lock_guard<std::recursive_mutex> g(ssdMutex);
+
+      std::ofstream out(prefix + "blocks.csv");
+      if (!out.is_open()) {
+         throw std::runtime_error("could not open " + prefix + "blocks.csv");
+      }
+      out << "block,eraseCount,validCnt,writePos,gcAge,gcGeneration,writtenByGc,group,readsSinceErase\n";
+      for (auto& b : _blocks) {
+         out << b.blockId << "," << b.eraseCount() << "," << b.validCnt() << "," << b.writePos() << "," << b.gcAge << ","
+             << b.gcGeneration << "," << b.writtenByGc << "," << b.group << "," << b.readsSinceErase << "\n";
+      }
    }
 };
 
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "SSD.hpp"
+#include "Env.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+// Discrete-event timing on top of SSD's media hook, virtual clock in ns.
+//
+// Dies are the SSD's LUNs (pages interleaved, SSD::lunOfAddr), die d sits on channel
+// d % channels. A read occupies its die for tR and then the channel for the page
+// transfer, a program the channel first and then the die for tPROG. An erase occupies
+// each die the block is striped over for tBERS, only those dies.
+//
+// The host either submits at a fixed rate (IOPS, open loop) or keeps QD operations
+// outstanding (closed loop). Writes are acknowledged from the write buffer unless they
+// program a page. With foreground GC, a host write also waits for the GC work it
+// triggered; with background GC that work only keeps the dies busy.
+class TimingModel {
+public:
+   struct Config {
+      uint64_t read = 60 * 1000;      // tR
+      uint64_t program = 600 * 1000;  // tPROG
+      uint64_t erase = 3000 * 1000;   // tBERS
+      uint64_t transfer = 5 * 1000;   // one page over the channel
+      uint64_t channels = 8;
+      uint64_t queueDepth = 0;        // 0: open loop with iops
+      double iops = 100000;
+      bool foregroundGc = true;
+
+      // TR, TPROG, TBERS in us; CHANNEL_MBS sets the page transfer time
+      static Config fromEnv(uint64_t pageSize) {
+         Config c;
+         c.read = getEnv("TR", (float)(c.read / 1000)) * 1000;
+         c.program = getEnv("TPROG", (float)(c.program / 1000)) * 1000;
+         c.erase = getEnv("TBERS", (float)(c.erase / 1000)) * 1000;
+         c.transfer = pageSize * 1000.0 / getEnv("CHANNEL_MBS", 800.0f);
+         c.channels = std::max<uint64_t>(1, getEnv("CHANNELS", (float)c.channels));
+         c.queueDepth = getEnv("QD", 0.0f);
+         c.iops = getEnv("IOPS", (float)c.iops);
+         std::string gcMode = getEnv("GC_MODE", "fg");
+         if (gcMode != "fg" && gcMode != "bg") {
+            throw std::runtime_error("GC_MODE must be fg or bg");
+         }
+         c.foregroundGc = gcMode == "fg";
+         return c;
+      }
+   };
+
+private:
+   const Config cfg;
+   const SSD& ssd;
+   std::vector<uint64_t> dieBusy;
+   std::vector<uint64_t> channelBusy;
+   uint64_t _now = 0;
+   // current host operation
+   uint64_t hostEnd = 0;
+   uint64_t allEnd = 0;
+   std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> outstanding;
+   std::vector<uint64_t> opCnt = std::vector<uint64_t>(5, 0);
+   uint64_t _dieBusyTime = 0;
+
+   static bool isHostOp(SSD::MediaOp op) {
+      return op == SSD::MediaOp::HostRead || op == SSD::MediaOp::HostProgram;
+   }
+
+public:
+   TimingModel(const SSD& ssd, Config cfg)
+      : cfg(cfg), ssd(ssd), dieBusy(ssd.lunCnt(), 0), channelBusy(std::min(cfg.channels, ssd.lunCnt()), 0) {}
+
+   // schedules one NAND operation, returns its completion time
+   uint64_t submit(SSD::MediaOp op, uint64_t physAddr) {
+      opCnt[(int)op]++;
+      uint64_t end;
+      if (op == SSD::MediaOp::Erase) {
+         // the block's share on each die is erased independently
+         const uint64_t spanned = std::min<uint64_t>(ssd.pagesPerZone, dieBusy.size());
+         end = _now;
+         for (uint64_t i = 0; i < spanned; i++) {
+            uint64_t& die = dieBusy[ssd.lunOfAddr(physAddr + i)];
+            die = std::max(_now, die) + cfg.erase;
+            end = std::max(end, die);
+         }
+         _dieBusyTime += spanned * cfg.erase;
+      } else {
+         const uint64_t die = ssd.lunOfAddr(physAddr);
+         uint64_t& ch = channelBusy[die % channelBusy.size()];
+         if (op == SSD::MediaOp::HostRead || op == SSD::MediaOp::GcRead) {
+            uint64_t senseEnd = std::max(_now, dieBusy[die]) + cfg.read;
+            end = std::max(senseEnd, ch) + cfg.transfer;
+            ch = end;
+            dieBusy[die] = end; // data register is busy until transferred
+            _dieBusyTime += cfg.read;
+         } else {
+            uint64_t xferEnd = std::max(_now, ch) + cfg.transfer;
+            ch = xferEnd;
+            end = std::max(xferEnd, dieBusy[die]) + cfg.program;
+            dieBusy[die] = end;
+            _dieBusyTime += cfg.program;
+         }
+      }
+      allEnd = std::max(allEnd, end);
+      if (isHostOp(op)) {
+         hostEnd = std::max(hostEnd, end);
+      }
+      return end;
+   }
+
+   // call before the host operation touches the SSD
+   void beginHostOp() {
+      if (cfg.queueDepth > 0) {
+         while (outstanding.size() >= cfg.queueDepth) {
+            _now = std::max(_now, outstanding.top());
+            outstanding.pop();
+         }
+      } else {
+         _now += 1e9 / cfg.iops;
+      }
+      hostEnd = _now;
+      allEnd = _now;
+   }
+
+   // beginHostOp for a host with its own clock (iob's sim engine), t in ns
+   void beginHostOpAt(uint64_t t) {
+      _now = std::max(_now, t);
+      while (!outstanding.empty() && outstanding.top() <= _now) {
+         outstanding.pop();
+      }
+      hostEnd = _now;
+      allEnd = _now;
+   }
+
+   // returns the latency of the host operation
+   uint64_t endHostOp() {
+      const uint64_t end = cfg.foregroundGc ? allEnd : hostEnd;
+      if (cfg.queueDepth > 0) {
+         outstanding.push(end);
+      }
+      return end - _now;
+   }
+
+   // no host I/O until t, everything outstanding completes
+   void idleUntil(uint64_t t) {
+      _now = std::max(_now, t);
+      while (!outstanding.empty()) {
+         _now = std::max(_now, outstanding.top());
+         outstanding.pop();
+      }
+   }
+   uint64_t latestDieBusy() const { return *std::max_element(dieBusy.begin(), dieBusy.end()); }
+   // when everything submitted so far has completed, later than now() under overload
+   uint64_t completionTime() const { return std::max(_now, latestDieBusy()); }
+
+   uint64_t now() const { return _now; }
+   uint64_t ops(SSD::MediaOp op) const { return opCnt[(int)op]; }
+   // sum over all dies, divide by elapsed time * dies for the utilization
+   uint64_t dieBusyTime() const { return _dieBusyTime; }
+   uint64_t dies() const { return dieBusy.size(); }
+   const Config& config() const { return cfg; }
+
+   void print(std::ostream& out) const {
+      out << "timing: dies: " << dieBusy.size() << " channels: " << channelBusy.size()
+          << " tR: " << cfg.read << "ns tPROG: " << cfg.program << "ns tBERS: " << cfg.erase << "ns xfer: " << cfg.transfer << "ns";
+      if (cfg.queueDepth > 0) {
+         out << " QD: " << cfg.queueDepth;
+      } else {
+         out << " IOPS: " << cfg.iops;
+      }
+      out << " gc: " << (cfg.foregroundGc ? "fg" : "bg") << std::endl;
+   }
+};
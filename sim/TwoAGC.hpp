@@ -5,6 +5,7 @@
 
 #include "SSD.hpp"
 #include "TwoAFormula.hpp"
+#include "WearLeveling.hpp"
 
 #include <cstdint>
 #include <fstream>
@@ -31,7 +32,7 @@ class TwoAGC {
    long statsGreedyGC = 0;
    std::random_device rd;
    std::mt19937_64 gen{rd()};
-   std::list<uint64_t> freeBlocks;
+   FreeBlockPool freeBlocks{ssd};
    struct TTElement {
       static constexpr long maxTimestamps = 4;
       std::list<long> timestamps;
@@ -125,6 +126,12 @@ public:
       ensure(selectedWriteHeadId >= 0 && selectedWriteHeadId < maxWriteHeads);
       return selectedWriteHeadId;
    }
+   // the write head is chosen per page
+   void writePages(uint64_t firstPageId, uint64_t count) {
+      for (uint64_t p = firstPageId; p < firstPageId + count; p++) {
+         writePage(p);
+      }
+   }
    void writePage(uint64_t pageId) {
       // select write block based on TT
       int selectedWriteHeadId = chooseWriteHead(pageId);
@@ -326,6 +333,24 @@ public:
       statsWriteHeadGcCounter[gcGroup]++;
       freeBlocks.push_back(freeBlock);
    }
+   uint64_t freeBlockCnt() const { return freeBlocks.size(); }
+   uint64_t trimRange(uint64_t first, uint64_t count) { return ssd.trimRange(first, count); }
+   void gcStep() { performGC(); }
+   // per repetition counters are reset by the registry, also for stats()
+   void registerMetrics(MetricsRegistry& m) {
+      m.counters("whWrites", statsWriteHeadWrites);
+      m.counters("whGc", statsWriteHeadGcCounter);
+      m.counters("whGcCompactions", statsWriteHeadGcCompactionCounter);
+      m.counter("smartGC", statsSmartGC);
+      m.counter("greedyGC", statsGreedyGC);
+      m.gauge("optWA", [this]() {
+         // the formula needs writes on every head
+         if (std::find(statsWriteHeadWrites.begin(), statsWriteHeadWrites.end(), 0) != statsWriteHeadWrites.end()) {
+            return 0.0;
+         }
+         return newOptWA(ssd.ssdFill, statsWriteHeadWrites).second;
+      });
+   }
    void stats() {
       std::cout << "TwoA stats: (per group)" << std::endl;
       std::cout << "percentiles: ";
@@ -356,7 +381,6 @@ public:
       std::cout << "relativeWrites%: ";
       for (int i = 0; i < maxWriteHeads; i++) {
          std::cout << std::round((float)statsWriteHeadWrites[i] / writeSum*1000)/10 << " ";
-         statsWriteHeadWrites[i] = 0;
       }
       std::cout << std::endl;
       std::cout << "GCCounter: ";
@@ -384,10 +408,6 @@ public:
          std::cout << std::round(statsWriteHeadGcCompactionCounter[i] / (float)totalCompactions *1000)/10  << " ";
       }
       std::cout << std::endl;
-      for (int i = 0; i < maxWriteHeads; i++) {
-         statsWriteHeadGcCounter[i] = 0;
-         statsWriteHeadGcCompactionCounter[i] = 0;
-      }
       std::cout << "Blocks: ";
       for (auto& [group, blocks] : blocksPerGroup) {
          if (group >= 0) {
@@ -425,8 +445,6 @@ public:
       std::cout << "optimalAtotal: " << optimalWAtotal << " (samples: " << sumWritesTotal << "  == " << round((float)sumWritesTotal/ssd.logicalPages*10)/10 << "x SSD) ";
       std::cout << " optimalWACurrent: " << optimalWACurrent << " optimalWAFull: " << optimalWAFull;
       std::cout << " greedyWACurrent: " << greedyApproxWA(currentFill) << " greedyWAFull: " << greedyApproxWA(ssd.ssdFill) <<std::endl;
-      statsSmartGC = 0;
-      statsGreedyGC = 0;
       std::cout << std::endl;
    }
    void resetStats() {
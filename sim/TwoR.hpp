@@ -1,6 +1,7 @@
 #pragma once
 
 #include "SSD.hpp"
+#include "WearLeveling.hpp"
 
 #include <algorithm>
 #include <vector>
@@ -9,8 +10,9 @@
 #include <set>
 
 class TwoR {
+    SSD& ssd;
     uint64_t currentBlock;
-    std::list<uint64_t> freeBlocks;
+    FreeBlockPool freeBlocks{ssd};
     std::vector<uint64_t> normalBlocks;
     std::vector<uint64_t> coldBlocks;
 
@@ -30,7 +32,6 @@ class TwoR {
     std::default_random_engine generator{rd()};
     std::uniform_int_distribution<int> distribution{0, 100};
 
-    SSD& ssd;
     std::string gcAlgorithm;
 
 public:
@@ -59,6 +60,15 @@ public:
     }
 
     void writePage(uint64_t pageId) {
+        openBlock();
+        ssd.writePage(pageId, currentBlock);
+    }
+
+    void writePages(uint64_t firstPageId, uint64_t count) {
+        ssd.writePages(firstPageId, count, [&]() { return openBlock(); });
+    }
+
+    uint64_t openBlock() {
         if (!ssd.blocks()[currentBlock].canWrite()) {
             fifoList.push_back(currentBlock);
             normalBlocks.push_back(currentBlock);
@@ -70,18 +80,25 @@ public:
             freeBlocks.pop_front();
             ensure(ssd.blocks()[currentBlock].canWrite());
         }
-        ssd.writePage(pageId, currentBlock);
+        return currentBlock;
     }
 
     void performGC() {
         if (freeBlocks.empty()) {
-            if (gcAlgorithm == "2r-fifo") {
-                garbageCollect2RFIFO();
-            } else if (gcAlgorithm == "2r-greedy") {
-                garbageCollect2RGreedy();
-            } else {
-                throw std::runtime_error("unknown GC algorithm");
-            }
+            gcStep();
+        }
+    }
+
+    uint64_t freeBlockCnt() const { return freeBlocks.size(); }
+    uint64_t trimRange(uint64_t first, uint64_t count) { return ssd.trimRange(first, count); }
+
+    void gcStep() {
+        if (gcAlgorithm == "2r-fifo") {
+            garbageCollect2RFIFO();
+        } else if (gcAlgorithm == "2r-greedy") {
+            garbageCollect2RGreedy();
+        } else {
+            throw std::runtime_error("unknown GC algorithm");
         }
     }
 
@@ -279,6 +296,11 @@ public:
         ensure(freeBlocks.size());
         victimIds.clear();
     }
+    void registerMetrics(MetricsRegistry& m) {
+        m.intGauge("normalBlocks", [this]() { return (uint64_t)normalBlocks.size(); });
+        m.intGauge("coldBlocks", [this]() { return (uint64_t)coldBlocks.size(); });
+    }
+
     void stats() {
         std::cout << "Greedy stats" << std::endl;
     }
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "SSD.hpp"
+#include "Env.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// WL=fifo (default): free blocks are reused in the order GC freed them.
+// WL=dynamic: the free block with the fewest erases is allocated next.
+// WL=static: dynamic, plus cold data is migrated off the least erased block onto worn
+// free blocks whenever max - min erase count exceeds WL_DELTA.
+struct WearLevelingConfig {
+   bool dynamic = false;
+   bool staticWl = false;
+   uint64_t maxEraseDelta = 100;
+
+   static WearLevelingConfig fromEnv() {
+      WearLevelingConfig c;
+      std::string wl = getEnv("WL", "fifo");
+      if (wl != "fifo" && wl != "dynamic" && wl != "static") {
+         throw std::runtime_error("WL must be fifo, dynamic or static");
+      }
+      c.dynamic = wl != "fifo";
+      c.staticWl = wl == "static";
+      c.maxEraseDelta = getEnv("WL_DELTA", (float)c.maxEraseDelta);
+      return c;
+   }
+};
+
+// Free blocks of a GC policy, same interface as the std::list it replaces. In dynamic
+// mode an ordered set acts as a min-heap on the erase count (a block is not erased
+// while it is free, so the keys do not change) and also gives the most worn block.
+class FreeBlockPool {
+   const SSD& ssd;
+   const bool dynamic;
+   std::deque<uint64_t> fifo;
+   std::set<std::pair<uint64_t, uint64_t>> byEraseCount; // (eraseCount, blockId)
+   std::vector<bool> inPool;
+
+public:
+   FreeBlockPool(const SSD& ssd, WearLevelingConfig cfg = WearLevelingConfig::fromEnv())
+      : ssd(ssd), dynamic(cfg.dynamic), inPool(ssd.zones, false) {}
+
+   void push_back(uint64_t blockId) {
+      if (inPool[blockId]) {
+         return;
+      }
+      inPool[blockId] = true;
+      if (dynamic) {
+         byEraseCount.emplace(ssd.blocks()[blockId].eraseCount(), blockId);
+      } else {
+         fifo.push_back(blockId);
+      }
+   }
+   uint64_t front() const { return dynamic ? byEraseCount.begin()->second : fifo.front(); }
+   void pop_front() {
+      inPool[front()] = false;
+      if (dynamic) {
+         byEraseCount.erase(byEraseCount.begin());
+      } else {
+         fifo.pop_front();
+      }
+   }
+   bool empty() const { return dynamic ? byEraseCount.empty() : fifo.empty(); }
+   uint64_t size() const { return dynamic ? byEraseCount.size() : fifo.size(); }
+   bool contains(uint64_t blockId) const { return inPool[blockId]; }
+
+   // the free block with the most erases
+   uint64_t mostWorn() const {
+      if (dynamic) {
+         return byEraseCount.rbegin()->second;
+      }
+      return *std::max_element(fifo.begin(), fifo.end(), [&](uint64_t a, uint64_t b) {
+         return ssd.blocks()[a].eraseCount() < ssd.blocks()[b].eraseCount();
+      });
+   }
+   // removes blockId from the pool
+   void take(uint64_t blockId) {
+      if (!inPool[blockId]) {
+         return;
+      }
+      inPool[blockId] = false;
+      if (dynamic) {
+         byEraseCount.erase({ssd.blocks()[blockId].eraseCount(), blockId});
+      } else {
+         fifo.erase(std::find(fifo.begin(), fifo.end(), blockId));
+      }
+   }
+};
+
+// Static wear leveling, checked before the policy allocates a block. Only for policies
+// that find their victims by scanning all blocks; inUse marks the policy's open blocks.
+// The erase count spread comes from the SSD's running stats, blocks are only scanned for
+// the coldest one when it exceeds maxEraseDelta.
+class StaticWearLeveler {
+   SSD& ssd;
+   const bool enabled;
+   const uint64_t maxEraseDelta;
+   uint64_t checkedAtErases = std::numeric_limits<uint64_t>::max();
+
+public:
+   StaticWearLeveler(SSD& ssd, WearLevelingConfig cfg = WearLevelingConfig::fromEnv())
+      : ssd(ssd), enabled(cfg.staticWl), maxEraseDelta(cfg.maxEraseDelta) {}
+
+   // moves the coldest block's data onto the most worn free blocks and returns the erased
+   // cold block to the pool. Returns the last worn block if it has room left, the caller
+   // allocates it next and fills it up, otherwise SSD::unused.
+   uint64_t check(FreeBlockPool& freeBlocks, std::function<bool(uint64_t)> inUse) {
+      // erase counts only change with erases
+      if (!enabled || freeBlocks.empty() || ssd.erases() == checkedAtErases) {
+         return SSD::unused;
+      }
+      checkedAtErases = ssd.erases();
+      const auto wear = ssd.eraseCountStats();
+      if (wear.max - wear.min <= maxEraseDelta) {
+         return SSD::unused;
+      }
+      uint64_t coldest = SSD::unused;
+      uint64_t minErase = std::numeric_limits<uint64_t>::max();
+      for (auto& b : ssd.blocks()) {
+         if (b.eraseCount() < minErase && b.fullyWritten() && !freeBlocks.contains(b.blockId) && !inUse(b.blockId)) {
+            coldest = b.blockId;
+            minErase = b.eraseCount();
+         }
+      }
+      if (coldest == SSD::unused || wear.max - minErase <= maxEraseDelta) {
+         return SSD::unused;
+      }
+      // GC may have compacted a victim into a free block, the cold data can need several
+      std::vector<uint64_t> worn;
+      uint64_t room = 0;
+      while (room < ssd.blocks()[coldest].validCnt() && !freeBlocks.empty()) {
+         const uint64_t b = freeBlocks.mostWorn();
+         if (ssd.blocks()[b].eraseCount() <= minErase) {
+            break;
+         }
+         freeBlocks.take(b);
+         worn.push_back(b);
+         room += ssd.pagesPerZone - ssd.blocks()[b].writePos();
+      }
+      if (room < ssd.blocks()[coldest].validCnt()) {
+         for (uint64_t b : worn) {
+            freeBlocks.push_back(b);
+         }
+         return SSD::unused;
+      }
+      ssd.migrateBlock(coldest, worn);
+      freeBlocks.push_back(coldest);
+      return !worn.empty() && ssd.blocks()[worn.back()].canWrite() ? worn.back() : SSD::unused;
+   }
+};
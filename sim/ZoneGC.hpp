@@ -0,0 +1,194 @@
+#pragma once
+
+#include "SSD.hpp"
+#include "ZonedDevice.hpp"
+#include "Metrics.hpp"
+#include "Env.hpp"
+#include "PatternGen.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Host side of DEVICE=zns: the host maps logical pages into zones (the SSD's mapping doubles
+// as the host's), appends host writes to one open zone per stream (HINT_STREAMS like
+// greedy, hint % streams) and copies live pages out of a zone before it resets it. The
+// copies are physical writes like device GC in the conventional model, so the WA columns
+// compare both. Victims among the full zones:
+//   greedy: fewest live pages
+//   cb:     LFS cost-benefit, highest (1 - u) / (1 + u) * age, age in host writes since the
+//           zone was last written
+//   nowa:   only zones without live pages, relocations are the fallback (zoneGcForced)
+class ZoneGC {
+public:
+   enum class Policy { Greedy, CostBenefit, NoWA };
+
+private:
+   // empty zones kept back for relocations, a victim frees one before its copies fill one
+   static constexpr uint64_t reserve = 2;
+
+   SSD& ssd;
+   ZonedDevice dev;
+   const Policy policy;
+   const std::string policyName;
+   std::deque<uint64_t> emptyZones;
+   std::vector<int64_t> streamZones;
+   int64_t gcZone = -1;
+   std::vector<uint64_t> lastWrite; // host write clock
+   uint64_t clock = 0;
+   uint64_t relocated = 0;
+   uint64_t gcForced = 0;
+
+   static Policy policyOf(const std::string& name) {
+      if (name == "greedy") return Policy::Greedy;
+      if (name == "cb") return Policy::CostBenefit;
+      if (name == "nowa") return Policy::NoWA;
+      throw std::runtime_error("DEVICE=zns: GC must be greedy, cb or nowa, not " + name);
+   }
+
+   uint64_t takeEmptyZone() {
+      ensurem(!emptyZones.empty(), "zns: out of empty zones, lower SSDFILL");
+      const uint64_t z = emptyZones.front();
+      emptyZones.pop_front();
+      lastWrite[z] = 0;
+      return z;
+   }
+
+   uint64_t openZone(int64_t& zone) {
+      if (zone < 0 || dev.state(zone) == ZonedDevice::State::Full) {
+         zone = takeEmptyZone();
+      }
+      return zone;
+   }
+
+   int64_t pickVictim() const {
+      const uint64_t cap = dev.zoneCapacity();
+      int64_t victim = -1;
+      double best = -1;
+      for (uint64_t z = 0; z < dev.zones(); z++) {
+         if (dev.state(z) != ZonedDevice::State::Full) {
+            continue;
+         }
+         const uint64_t valid = ssd.blocks()[z].validCnt();
+         if (valid == cap) {
+            continue;
+         }
+         double score;
+         if (policy == Policy::CostBenefit) {
+            const double u = (double)valid / cap;
+            score = (1 - u) / (1 + u) * (double)(clock - lastWrite[z] + 1);
+         } else {
+            score = (double)(cap - valid);
+         }
+         if (score > best) {
+            best = score;
+            victim = z;
+         }
+      }
+      return victim;
+   }
+
+   void relocate(uint64_t victim) {
+      const SSD::Block& block = ssd.blocks()[victim];
+      for (uint64_t p = 0; p < block.writePos() && block.validCnt() > 0; p++) {
+         const uint64_t logPage = block.ptl()[p];
+         if (logPage == SSD::unused) {
+            continue;
+         }
+         ssd.gcRead(ssd.getAddr(victim, p));
+         const uint64_t z = openZone(gcZone);
+         dev.append(z, logPage, false);
+         // relocated data keeps its age, the youngest victim it holds
+         lastWrite[z] = std::max(lastWrite[z], lastWrite[victim]);
+         relocated++;
+      }
+   }
+
+public:
+   ZoneGC(SSD& ssd, const std::string& gc)
+      : ssd(ssd)
+      , dev(ssd, ZonedDevice::Config::fromEnv())
+      , policy(policyOf(gc))
+      , policyName(gc)
+      , lastWrite(ssd.zones, 0)
+   {
+      for (uint64_t z = 0; z < ssd.zones; z++) {
+         emptyZones.push_back(z);
+      }
+      const uint64_t streams = std::max<uint64_t>(1, getEnv("HINT_STREAMS", 0.0f));
+      if (streams + 1 > dev.config().maxActive) {
+         throw std::runtime_error("DEVICE=zns: HINT_STREAMS plus the GC zone exceed ZNS_MAX_ACTIVE");
+      }
+      if (ssd.zones < streams + 1 + reserve + 1) {
+         throw std::runtime_error("DEVICE=zns: too few zones");
+      }
+      streamZones.assign(streams, -1);
+   }
+
+   std::string name() { return "zns-" + policyName; }
+
+   void writePage(uint64_t pageId) { writePage(pageId, iob::PatternGen::noHint); }
+
+   void writePage(uint64_t pageId, uint8_t hint) {
+      int64_t& zone = streamZones[hint == iob::PatternGen::noHint ? 0 : hint % streamZones.size()];
+      if (zone < 0 || dev.state(zone) == ZonedDevice::State::Full) {
+         while (emptyZones.size() <= reserve) {
+            gcStep();
+         }
+      }
+      openZone(zone);
+      dev.append(zone, pageId);
+      lastWrite[zone] = ++clock;
+   }
+
+   void writePages(uint64_t firstPageId, uint64_t count) {
+      for (uint64_t p = firstPageId; p < firstPageId + count; p++) {
+         writePage(p);
+      }
+   }
+
+   uint64_t trimRange(uint64_t first, uint64_t count) { return ssd.trimRange(first, count); }
+
+   uint64_t freeBlockCnt() const { return emptyZones.size(); }
+
+   // reclaims one zone
+   void gcStep() {
+      int64_t victim = -1;
+      if (policy == Policy::NoWA) {
+         for (uint64_t z = 0; z < dev.zones() && victim < 0; z++) {
+            if (dev.state(z) == ZonedDevice::State::Full && ssd.blocks()[z].validCnt() == 0) {
+               victim = z;
+            }
+         }
+         if (victim < 0) {
+            gcForced++;
+         }
+      }
+      if (victim < 0) {
+         victim = pickVictim();
+      }
+      ensurem(victim >= 0, "zns: no zone with dead pages to reclaim, lower SSDFILL");
+      relocate(victim);
+      dev.reset(victim);
+      emptyZones.push_back(victim);
+   }
+
+   void registerMetrics(MetricsRegistry& m) {
+      m.counter("zoneRelocated", relocated);
+      m.counter("zoneResets", dev.resets);
+      m.counter("zoneGcForced", gcForced);
+      m.counter("zoneImplicitCloses", dev.implicitCloses);
+      m.intGauge("activeZones", [this]() { return dev.activeCnt(); });
+   }
+
+   void stats() {
+      std::cout << name() << " relocated: " << relocated << " resets: " << dev.resets
+                << " forced: " << gcForced << " active: " << dev.activeCnt() << std::endl;
+   }
+
+   void resetStats() {}
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "SSD.hpp"
+#include "Env.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Host-managed zoned device (ZNS) on the SSD's blocks, one zone per erase block. A zone is
+// written at its write pointer only (write or append) and reset as a whole; the device has
+// no GC of its own, so its WA is 1 and relocations are up to the host (ZoneGC.hpp).
+// An empty zone takes an active resource on its first write or explicit open and gives it
+// back when it is full, finished or reset; open zones also take an open resource. Like a
+// drive, the device closes the least recently opened implicitly opened zone when the host
+// opens one more than ZNS_MAX_OPEN.
+class ZonedDevice {
+public:
+   enum class State : uint8_t { Empty, ImplicitOpen, ExplicitOpen, Closed, Full };
+
+   struct Config {
+      uint64_t maxActive = 14;
+      uint64_t maxOpen = 14;
+
+      static Config fromEnv() {
+         Config c;
+         c.maxActive = getEnv("ZNS_MAX_ACTIVE", (float)c.maxActive);
+         c.maxOpen = getEnv("ZNS_MAX_OPEN", (float)c.maxActive);
+         return c;
+      }
+   };
+
+private:
+   SSD& ssd;
+   const Config cfg;
+   std::vector<State> _state;
+   std::vector<uint64_t> _openedAt; // for implicit closes
+   uint64_t _openClock = 0;
+   uint64_t _openCnt = 0;
+   uint64_t _activeCnt = 0;
+
+   static bool isOpen(State s) { return s == State::ImplicitOpen || s == State::ExplicitOpen; }
+
+   std::string zoneError(const std::string& op, uint64_t zone) const {
+      return "zns: " + op + " of zone " + std::to_string(zone) + " in state " + std::to_string((int)_state[zone]);
+   }
+
+   void checkZone(uint64_t zone) const {
+      if (zone >= _state.size()) {
+         throw std::out_of_range("zns: zone " + std::to_string(zone) + " out of range");
+      }
+   }
+
+   void makeOpen(uint64_t zone, State to) {
+      if (_state[zone] == State::Empty && _activeCnt == cfg.maxActive) {
+         throw std::runtime_error("zns: more than ZNS_MAX_ACTIVE=" + std::to_string(cfg.maxActive) + " active zones");
+      }
+      if (_openCnt == cfg.maxOpen) {
+         uint64_t victim = _state.size();
+         for (uint64_t z = 0; z < _state.size(); z++) {
+            if (_state[z] == State::ImplicitOpen && (victim == _state.size() || _openedAt[z] < _openedAt[victim])) {
+               victim = z;
+            }
+         }
+         if (victim == _state.size()) {
+            throw std::runtime_error("zns: more than ZNS_MAX_OPEN=" + std::to_string(cfg.maxOpen) + " explicitly open zones");
+         }
+         close(victim);
+         implicitCloses++;
+      }
+      if (_state[zone] == State::Empty) {
+         _activeCnt++;
+      }
+      _openCnt++;
+      _state[zone] = to;
+      _openedAt[zone] = _openClock++;
+   }
+
+   // gives back the resources of an open or closed zone
+   void release(uint64_t zone) {
+      if (isOpen(_state[zone])) {
+         _openCnt--;
+      }
+      if (isOpen(_state[zone]) || _state[zone] == State::Closed) {
+         _activeCnt--;
+      }
+   }
+
+   void writeAt(uint64_t zone, uint64_t logPage, bool hostWrite) {
+      if (_state[zone] == State::Full) {
+         throw std::logic_error(zoneError("write", zone));
+      }
+      if (!isOpen(_state[zone])) {
+         makeOpen(zone, State::ImplicitOpen);
+      }
+      ssd.writeZonePage(logPage, zone, hostWrite);
+      if (writePointer(zone) == zoneCapacity()) {
+         release(zone);
+         _state[zone] = State::Full;
+      }
+   }
+
+public:
+   uint64_t resets = 0;
+   uint64_t finishes = 0;
+   uint64_t implicitCloses = 0;
+
+   ZonedDevice(SSD& ssd, Config cfg) : ssd(ssd), cfg(cfg), _state(ssd.zones, State::Empty), _openedAt(ssd.zones, 0) {
+      if (cfg.maxActive == 0 || cfg.maxOpen == 0 || cfg.maxOpen > cfg.maxActive) {
+         throw std::invalid_argument("zns: need 0 < ZNS_MAX_OPEN <= ZNS_MAX_ACTIVE");
+      }
+      for (uint64_t z = 0; z < ssd.zones; z++) {
+         ensurem(ssd.blocks()[z].isErased(), "zns: the device must start empty");
+      }
+   }
+
+   uint64_t zones() const { return _state.size(); }
+   uint64_t zoneCapacity() const { return ssd.pagesPerZone; }
+   State state(uint64_t zone) const { return _state.at(zone); }
+   uint64_t writePointer(uint64_t zone) const { return ssd.blocks()[zone].writePos(); }
+   uint64_t openCnt() const { return _openCnt; }
+   uint64_t activeCnt() const { return _activeCnt; }
+   const Config& config() const { return cfg; }
+
+   void open(uint64_t zone) {
+      checkZone(zone);
+      if (_state[zone] == State::Full) {
+         throw std::logic_error(zoneError("open", zone));
+      }
+      if (_state[zone] == State::ImplicitOpen) {
+         _state[zone] = State::ExplicitOpen;
+      } else if (_state[zone] != State::ExplicitOpen) {
+         makeOpen(zone, State::ExplicitOpen);
+      }
+   }
+
+   void close(uint64_t zone) {
+      checkZone(zone);
+      if (!isOpen(_state[zone])) {
+         throw std::logic_error(zoneError("close", zone));
+      }
+      _openCnt--;
+      if (writePointer(zone) == 0) {
+         _activeCnt--;
+         _state[zone] = State::Empty;
+      } else {
+         _state[zone] = State::Closed;
+      }
+   }
+
+   // the rest of the zone stays unwritten until the next reset
+   void finish(uint64_t zone) {
+      checkZone(zone);
+      if (_state[zone] == State::Full) {
+         return;
+      }
+      release(zone);
+      _state[zone] = State::Full;
+      finishes++;
+   }
+
+   // discards the zone's data: pages still mapped there are unmapped (the host relocates
+   // what it needs first)
+   void reset(uint64_t zone) {
+      checkZone(zone);
+      release(zone);
+      const SSD::Block& block = ssd.blocks()[zone];
+      for (uint64_t p = 0; p < block.writePos() && block.validCnt() > 0; p++) {
+         if (block.ptl()[p] != SSD::unused) {
+            ssd.trimPage(block.ptl()[p]);
+         }
+      }
+      if (!block.isErased() || _state[zone] != State::Empty) {
+         ssd.eraseBlock(zone);
+         resets++;
+      }
+      _state[zone] = State::Empty;
+   }
+
+   // writes logPage at the write pointer, returns the physical address it landed on
+   uint64_t append(uint64_t zone, uint64_t logPage, bool hostWrite = true) {
+      checkZone(zone);
+      const uint64_t addr = ssd.getAddr(zone, writePointer(zone));
+      writeAt(zone, logPage, hostWrite);
+      return addr;
+   }
+
+   // regular zone write: offset must be the write pointer
+   void write(uint64_t zone, uint64_t offset, uint64_t logPage, bool hostWrite = true) {
+      checkZone(zone);
+      if (offset != writePointer(zone)) {
+         throw std::invalid_argument("zns: write of zone " + std::to_string(zone) + " at " + std::to_string(offset) +
+                                     ", write pointer at " + std::to_string(writePointer(zone)));
+      }
+      writeAt(zone, logPage, hostWrite);
+   }
+};
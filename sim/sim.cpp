@@ -7,9 +7,16 @@
 #include "SSD.hpp"
 #include "Greedy.hpp"
 #include "TwoR.hpp"
+#include "Timing.hpp"
+#include "GCScheduler.hpp"
+#include "ZoneGC.hpp"
+#include "Endurance.hpp"
+#include "Metrics.hpp"
+#include "Hist.hpp"
 // #include "Deathtime.hpp"
 
 #include <cstdint>
+#include <deque>
 #include <iostream>
 #include <cassert>
 #include <random>
@@ -32,19 +39,50 @@ void runBench(GCAlgo &gc, SSD &ssd, PatternGen &pg, bool initLoad = false) {
     std::random_device randDevice;
     std::mt19937_64 rng{randDevice()};
 
+    // mixed workloads: RW is the write fraction like in iob
+    const double writeRatio = getEnv("RW", 1.0f);
+    std::uniform_real_distribution<double> rwDist(0, 1);
+    // reads have their own generator, the write pattern only advances on writes: uniform, or
+    // zipf over shuffled pages with READ_SKEW > 0
+    const double readSkew = getEnv("READ_SKEW", 0.0f);
+    PatternGen readPg(readSkew > 0 ? PatternGen::Pattern::Zipf : PatternGen::Pattern::Uniform, ssd.logicalPages, readSkew, readSkew > 0, "feistel");
+    // timing is always on for mixed workloads, TIMING=1 enables it for write-only runs
+    TimingModel timing(ssd, TimingModel::Config::fromEnv(ssd.pageSize));
+    GCScheduler<GCAlgo> gcScheduler(gc, ssd, timing, GCScheduler<GCAlgo>::Config::fromEnv());
+    const bool timed = writeRatio < 1 || getEnv("TIMING", 0.0f) > 0 || gcScheduler.needsTiming();
+    Hist<int, int> readLatHist{100000, 0, 100000}; // us
+    Hist<int, int> writeLatHist{100000, 0, 100000}; // us
+    readLatHist.resetData();
+    writeLatHist.resetData();
+    uint64_t repReads = 0;
+    uint64_t repTrimmed = 0;
+    ssd.setReadDisturbThreshold(getEnv("READ_DISTURB", 0.0f));
+    // ranges the pattern deleted (zone resets, file deletions) go to the SSD as trims,
+    // TRIM=0 only counts them, the SSD then learns about dead pages on overwrite
+    const bool trimEnabled = getEnv("TRIM", 1.0f) > 0;
+    auto applyTrims = [&]() {
+        uint64_t pages = 0;
+        for (uint64_t first, count; pg.nextTrim(first, count);) {
+            if (trimEnabled) {
+                gc.trimRange(first, count);
+            }
+            pages += count;
+        }
+        return pages;
+    };
+
     //cout << "writesPerRep: " << (float)((writesPerRep * pageSize) / (float)gb) << " GB" << endl;
 
     // seq init, guarantees ssd is full,
     if (initLoad) {
-        for (uint64_t i = 0; i < ssd.logicalPages; i++) {
-            gc.writePage(i);
-        }
+        gc.writePages(0, ssd.logicalPages);
 
         // a batch of writes based on access pattern to fill OP 
         //uint64_t writeOP = ssd.physicalPages - ssd.logicalPages;
         uint64_t writeOP = ssd.physicalPages;
         for (uint64_t i = 0; i < writeOP; i++) {
             uint64_t logPage = pg.accessPatternGenerator(rng);
+            applyTrims();
             gc.writePage(logPage);
         }
 
@@ -52,49 +90,185 @@ void runBench(GCAlgo &gc, SSD &ssd, PatternGen &pg, bool initLoad = false) {
         ssd.resetPhysicalCounters();
         gc.resetStats();
     }
-
-    std::ofstream logFile("runBench.csv");
-    if (!logFile.is_open()) {
-        std::cerr << "Error opening runBench log file." << std::endl;
-        return;
+    if (timed) {
+        cout << "RW: " << writeRatio << " ";
+        timing.print(cout);
+        gcScheduler.print(cout);
+        ssd.setMediaHook([&](SSD::MediaOp op, uint64_t physAddr) { timing.submit(op, physAddr); });
     }
 
-    std::string header = "sim,hash,rep,time,capacity,erase,pagesize,pattern,skew,zones,alpha,beta,ssdFill,freePercentaftergc,gc,runningWAF,cumulativeWAF";
-    cout << header << endl;
-    logFile << header << endl;
     std::string logHash = mean::getTimeStampStr();
+    EnduranceReport endurance(ssd, logHash);
 
-    // bench
-    uint64_t writesPerRep = ssd.logicalPages / 10.0; // 1/10th of ssd size
-    uint64_t numReps = pg.options.totalWrites / writesPerRep;
+    // bench: a row every SAMPLE_WRITES host writes (default 1/10th of ssd size) or, with
+    // SAMPLE_GC, after that many erases, whatever comes first
+    const uint64_t writesPerRep = std::max<uint64_t>(1, getEnv("SAMPLE_WRITES", (float)(uint64_t)(ssd.logicalPages / 10.0)));
+    const uint64_t erasesPerRep = getEnv("SAMPLE_GC", 0.0f);
+    // stop early once the running WAF of the last STEADY_WINDOW rows is within STEADY_TOL
+    // (relative); rows without GC (the SSD is still filling up) do not count
+    const double steadyTolerance = getEnv("STEADY_TOL", 0.0f);
+    const uint64_t steadyWindow = std::max<uint64_t>(2, getEnv("STEADY_WINDOW", 5.0f));
+    const double ewmaAlpha = getEnv("WAF_EWMA_ALPHA", 0.2f);
+    // SAMPLE_GC rows end after a number of erases, their count is not known up front
+    if (erasesPerRep == 0) {
+        cout << "numreps: " << (pg.options.totalWrites + writesPerRep - 1) / writesPerRep << (steadyTolerance > 0 ? " (at most)" : "") << endl;
+    }
+    // SAMPLE_GC counts erases per run of pages, keep runs within a block then
+    const uint64_t maxRun = erasesPerRep > 0 ? ssd.pagesPerZone : UINT64_MAX;
+    std::deque<float> recentWAF;
     uint64_t  cumulativePhysWrites = 0;  // Cumulative physical writes across all repetitions
     uint64_t  cumulativeLogWrites = 0;   // Cumulative logical writes across all repetitions
     auto start = mean::getSeconds();
-    for (uint64_t rep = 0; rep < numReps; rep++) {
-        for (uint64_t i = 0; i < writesPerRep; i++) {
-            uint64_t logPage = pg.accessPatternGenerator(rng);
-            gc.writePage(logPage);
-            cumulativeLogWrites++;
+
+    // per rep values, read by the metrics when the row is written
+    uint64_t rep = 0;
+    double elapsed = 0;
+    float currentWAF = 0;
+    float cumulativeWAF = 0;
+    double ewmaWAF = 0;
+    uint64_t repWrites = 0;
+    double simSeconds = 0;
+    bool partialRow = false;
+    uint64_t repStartBusy = 0;
+    MetricsRegistry metrics;
+    metrics.label("sim", "bench");
+    metrics.label("hash", logHash);
+    metrics.intGauge("rep", [&]() { return rep; });
+    metrics.gauge("time", [&]() { return elapsed; });
+    metrics.label("capacity", std::to_string(ssd.capacity));
+    metrics.label("erase", std::to_string(ssd.zoneSize));
+    metrics.label("pagesize", std::to_string(ssd.pageSize));
+    metrics.label("pattern", pg.options.patternString);
+    metrics.label("skew", std::to_string(pg.options.skewFactor));
+    metrics.label("zones", "'" + pg.patternDetails() + "'");
+    metrics.label("alpha", std::to_string(pg.options.alpha));
+    metrics.label("beta", std::to_string(pg.options.beta));
+    metrics.label("ssdFill", std::to_string(ssd.ssdFill));
+    metrics.gauge("freePercentaftergc", [&]() { return repWrites / (float)ssd.physWrites(); });
+    metrics.label("gc", gc.name());
+    metrics.gauge("runningWAF", [&]() { return currentWAF; });
+    metrics.gauge("cumulativeWAF", [&]() { return cumulativeWAF; });
+    metrics.label("rw", std::to_string(writeRatio));
+    metrics.counter("reads", repReads);
+    metrics.counter("trimmed", repTrimmed);
+    metrics.histogram("r", readLatHist, {"50", "99", "99.9"}, "us");
+    metrics.intGauge("readDisturbBlocks", [&]() { return ssd.readDisturbBlocks(); });
+    metrics.gauge("simSeconds", [&]() { return timed ? simSeconds : 0; });
+    // a partial last row mostly spans the previous rows' backlog, its rates are 0
+    metrics.gauge("hostIops", [&]() { return timed && !partialRow && simSeconds > 0 ? (repWrites + repReads) / simSeconds : 0; });
+    metrics.histogram("w", writeLatHist, {"50", "99", "99.9"}, "us");
+    metrics.gauge("dieUtil", [&]() {
+        return timed && !partialRow && simSeconds > 0 ? (timing.dieBusyTime() - repStartBusy) / (simSeconds * 1e9 * timing.dies()) : 0;
+    });
+    metrics.counter("fgGcSteps", gcScheduler.fgSteps);
+    metrics.counter("bgGcSteps", gcScheduler.bgSteps);
+    metrics.counter("idlePeriods", gcScheduler.idlePeriods);
+    metrics.intGauge("freeBlocks", [&]() { return gc.freeBlockCnt(); });
+    metrics.intGauge("hostWrites", [&]() { return repWrites; });
+    metrics.gauge("ssdwrites", [&]() { return (double)cumulativeLogWrites / ssd.logicalPages; });
+    metrics.gauge("ewmaWAF", [&]() { return ewmaWAF; });
+    metrics.intGauge("phase", [&]() { return pg.currentPhase(); });
+    if (pg.hasHostWA()) {
+        // the storage engine's own WA, times the SSD's for the whole write path
+        metrics.gauge("hostWA", [&]() { return pg.hostWA(); });
+        metrics.gauge("totalWA", [&]() { return pg.hostWA() * cumulativeWAF; });
+    }
+    ssd.registerMetrics(metrics);
+    gc.registerMetrics(metrics);
+    metrics.open("runBench", getEnv("STATS_FORMAT", "csv"));
+    cout << metrics.header() << endl;
+    // the policies' stdout stats, runBench has the same numbers
+    const bool printGcStats = getEnv("PRINT_GC_STATS", 0.0f) > 0;
+    bool warnedLatencyCap = false;
+
+    for (rep = 0; cumulativeLogWrites < pg.options.totalWrites; rep++) {
+        // the rep ends with its last completion, not its last arrival
+        const uint64_t repStartNs = timing.completionTime();
+        const uint64_t repStartErases = ssd.erases();
+        const uint64_t repEnd = std::min(writesPerRep, pg.options.totalWrites - cumulativeLogWrites);
+        repStartBusy = timing.dieBusyTime();
+        repWrites = 0;
+        while (repWrites < repEnd && (erasesPerRep == 0 || ssd.erases() - repStartErases < erasesPerRep)) {
+            if (timed) {
+                timing.beginHostOp();
+            }
+            if (writeRatio >= 1 || rwDist(rng) < writeRatio) {
+                uint8_t hint;
+                uint64_t logPage;
+                uint64_t pages = 1;
+                // untimed, consecutive pages (sequential, trace requests) are written at once
+                if (timed) {
+                    logPage = pg.accessPatternGenerator(rng, hint);
+                } else {
+                    pages = pg.accessPatternRun(rng, std::min(repEnd - repWrites, maxRun), logPage, hint);
+                }
+                repTrimmed += applyTrims();
+                gcScheduler.beforeHostWrite();
+                if (pages > 1) {
+                    gc.writePages(logPage, pages);
+                } else if constexpr (requires { gc.writePage(logPage, hint); }) {
+                    gc.writePage(logPage, hint);
+                } else {
+                    gc.writePage(logPage);
+                }
+                cumulativeLogWrites += pages;
+                repWrites += pages;
+                if (timed) {
+                    writeLatHist.increaseSlot(timing.endHostOp() / 1000);
+                }
+            } else {
+                uint64_t logPage = readPg.accessPatternGenerator(rng);
+                ssd.readPage(logPage);
+                readLatHist.increaseSlot(timing.endHostOp() / 1000);
+                repReads++;
+            }
+            if (timed) {
+                gcScheduler.afterHostOp();
+            }
         }
+        simSeconds = (timing.completionTime() - repStartNs) / 1e9;
 
         cumulativePhysWrites += ssd.physWrites();
-        float currentWAF = ((float)ssd.physWrites()) / writesPerRep;
-        float cumulativeWAF = (float)((float)cumulativePhysWrites / (float)cumulativeLogWrites);
-        auto now = mean::getSeconds();
-        string s = "bench," + logHash + "," + std::to_string(rep) + "," + std::to_string(now - start) + "," + std::to_string(ssd.capacity) + "," + std::to_string(ssd.zoneSize) + "," + std::to_string(ssd.pageSize) + ",";
-        s += pg.options.patternString + "," + std::to_string(pg.options.skewFactor) + ",'" + pg.patternDetails() + "'," + std::to_string(pg.options.alpha) + "," + std::to_string(pg.options.beta) + "," + std::to_string(ssd.ssdFill) + ",";
-        s += std::to_string(writesPerRep / (float)ssd.physWrites());
-        s += "," + gc.name() + "," + std::to_string(currentWAF) + "," + std::to_string(cumulativeWAF) + "\n";
-
-        cout << s << std::flush;
-        logFile << s << std::flush;
+        currentWAF = ((float)ssd.physWrites()) / repWrites;
+        cumulativeWAF = (float)((float)cumulativePhysWrites / (float)cumulativeLogWrites);
+        // the last row can be cut short by WRITES: it counts by its share of SAMPLE_WRITES in
+        // the EWMA and leaves the steady window alone
+        partialRow = repWrites < writesPerRep && (erasesPerRep == 0 || ssd.erases() - repStartErases < erasesPerRep);
+        const double alpha = partialRow ? ewmaAlpha * repWrites / writesPerRep : ewmaAlpha;
+        ewmaWAF = rep == 0 ? currentWAF : alpha * currentWAF + (1 - alpha) * ewmaWAF;
+        if (!partialRow && ssd.erases() == repStartErases) {
+            recentWAF.clear();
+        } else if (!partialRow) {
+            recentWAF.push_back(currentWAF);
+        }
+        if (recentWAF.size() > steadyWindow) {
+            recentWAF.pop_front();
+        }
+        elapsed = mean::getSeconds() - start;
+        if (timed && !warnedLatencyCap && (readLatHist.max >= readLatHist.to - 1 || writeLatHist.max >= writeLatHist.to - 1)) {
+            std::cerr << "warning: latencies reach the histogram cap (" << writeLatHist.to
+                      << "us), the device cannot keep up with the offered load and the percentiles are clipped" << endl;
+            warnedLatencyCap = true;
+        }
+        cout << metrics.writeRow() << endl;
+        endurance.writeRep(rep);
+        if (printGcStats) {
+            gc.stats();
+        }
+        metrics.resetCounters();
+        readLatHist.resetData();
+        writeLatHist.resetData();
         ssd.resetPhysicalCounters();
-        //ssd.printBlocksStats();
-        gc.stats();
+        if (steadyTolerance > 0 && recentWAF.size() == steadyWindow) {
+            auto [lo, hi] = std::minmax_element(recentWAF.begin(), recentWAF.end());
+            if (*hi - *lo <= steadyTolerance * ewmaWAF) {
+                cout << "steady state: WAF " << ewmaWAF << " after " << (double)cumulativeLogWrites / ssd.logicalPages << " device writes" << endl;
+                break;
+            }
+        }
     }
     //ssd.printBlocksStats();
-
-    logFile.close();
+    ssd.setMediaHook(nullptr);
 
     //pg.generateAccessFrequencyHistogram(ssd.writtenPages, ssd.ssdFill);
     // Save the access pattern data to file and generate the plot
@@ -120,14 +294,24 @@ int main() {
     
     // GC options
     string gcAlgorithm = getEnv("GC", "greedy");
+    // conventional: page-mapped FTL with device GC, zns: zoned device, GC runs on the host
+    string device = getEnv("DEVICE", "conventional");
+    if (device != "conventional" && device != "zns") {
+        throw std::runtime_error("DEVICE must be conventional or zns");
+    }
 
     auto pgOptions = iob::PatternGen::loadOptionsFromEnv(ssd.logicalPages, ssd.pageSize);
     // iob::PatternGen::printPatternHistorgram(pgOptions);
     // Pattern generation options
     PatternGen pg(pgOptions);
-    std::cout << "numreps: " << pg.options.totalWrites / ( ssd.logicalPages / 10.0) << std::endl;
+    if (pg.pattern == PatternGen::Pattern::Tenants) {
+        ssd.setTenants(pg.tenantOffsets());
+    }
 
-    if (gcAlgorithm == "greedy") {
+    if (device == "zns") {
+        ZoneGC zoneGc(ssd, gcAlgorithm);
+        runBench(zoneGc, ssd, pg, initLoad);
+    } else if (gcAlgorithm == "greedy") {
         GreedyGC greedy(ssd);
         runBench(greedy, ssd, pg,  initLoad);
     } else if (gcAlgorithm.contains("greedy-k")) {
@@ -161,5 +345,6 @@ int main() {
     } else {
         throw std::runtime_error("unknown gc algorithm: " + gcAlgorithm);
     }
+    ssd.writeStatsFile(prefix);
     return 0;
 }
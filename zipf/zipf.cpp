@@ -2,10 +2,66 @@
 #include <vector>
 #include <random>
 #include <iomanip>
+#include <chrono>
+#include <cmath>
 
 
 #include "../shared/Env.hpp"
-#include "../shared/RejectionInversionZipf.hpp"
+#include "../shared/ZipfSampler.hpp"
+#include "../shared/FeistelPermutation.hpp"
+
+// BENCH=1: samples/sec and distance to the exact distribution, rejection inversion vs alias table
+static int bench(long numberOfElements, double exponent, long samples, std::mt19937_64& rng) {
+    std::vector<double> pmf(numberOfElements);
+    double sum = 0;
+    for (long k = 0; k < numberOfElements; ++k) {
+        pmf[k] = std::pow((double)(k + 1), -exponent);
+        sum += pmf[k];
+    }
+    std::cout << "sampler,n,exp,samples,setup_ms,msamples_per_s,tvd,top1_expected,top1_observed" << std::endl;
+    for (auto kind : {ZipfSampler::Kind::Rejection, ZipfSampler::Kind::Table}) {
+        auto t0 = std::chrono::steady_clock::now();
+        ZipfSampler sampler(numberOfElements, exponent, kind);
+        auto t1 = std::chrono::steady_clock::now();
+        std::vector<long> accesses(numberOfElements, 0);
+        for (long i = 0; i < samples; ++i) {
+            accesses[sampler.sample(rng) - 1]++;
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        // total variation distance between the empirical and the exact distribution
+        double tvd = 0;
+        for (long k = 0; k < numberOfElements; ++k) {
+            tvd += std::abs((double)accesses[k] / samples - pmf[k] / sum);
+        }
+        tvd /= 2;
+        double setupMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        double secs = std::chrono::duration<double>(t2 - t1).count();
+        std::cout << (kind == ZipfSampler::Kind::Table ? "table" : "rejection") << "," << numberOfElements << "," << exponent << "," << samples
+                  << "," << setupMs << "," << samples / secs / 1e6 << "," << tvd
+                  << "," << pmf[0] / sum << "," << (double)accesses[0] / samples << std::endl;
+    }
+    return 0;
+}
+
+// CHECK=1: FeistelPermutation::verify over domain sizes that exercise the cycle walking,
+// n = 1, powers of two, odd n and n just above and below 4^k, with a few seeds each
+static int check() {
+    std::vector<uint64_t> sizes = {1, 2, 3, 5, 7, 1000, 12345, 999999};
+    for (uint64_t n = 4; n <= (1ull << 20); n *= 2) {
+        sizes.push_back(n);
+    }
+    for (uint64_t p = 4; p <= (1ull << 20); p *= 4) {
+        sizes.push_back(p - 1);
+        sizes.push_back(p + 1);
+    }
+    for (uint64_t n : sizes) {
+        for (uint64_t seed : {0ull, 1ull, 42ull}) {
+            FeistelPermutation(n, seed).verify();
+        }
+    }
+    std::cout << "FeistelPermutation: " << sizes.size() << " sizes ok" << std::endl;
+    return 0;
+}
 
 int main() {
     long numberOfElements = getEnv("N", 1000);
@@ -13,10 +69,16 @@ int main() {
     double exponent = getEnv("EXP", 0.5);
     std::random_device rd;
     std::mt19937_64 rng(rd());
+    if (getEnv("CHECK", 0) > 0) {
+        return check();
+    }
+    if (getEnv("BENCH", 0) > 0) {
+        return bench(numberOfElements, exponent, getEnv("SAMPLES", (float)samples), rng);
+    }
     long buckets = getEnv("BUCKETS", 20);
     long elementsPerBucket = numberOfElements % buckets == 0 ? numberOfElements / buckets : (numberOfElements / buckets)+1;
     
-    RejectionInversionZipfSampler zipfSampler(numberOfElements, exponent);
+    ZipfSampler zipfSampler(numberOfElements, exponent);
     
     std::vector<long> accesses(numberOfElements, 0);
     for(long i = 0; i < samples; ++i) {